@@ -0,0 +1,46 @@
+#include "BatchBuilder.h"
+#include <exception>
+#include <future>
+
+BatchBuilder::BatchBuilder(unsigned int threadCount /*= 0*/)
+	: m_pool(threadCount)
+{
+}
+
+std::vector<BatchResult> BatchBuilder::Build(const std::vector<std::string>& filePaths, bool combineStates /*= true*/, bool onlyOutput /*= false*/, bool streamFrames /*= false*/, const ProcessFunction& process /*= nullptr*/)
+{
+	std::vector<BatchResult> results(filePaths.size());
+	std::vector<std::future<void>> futures;
+	futures.reserve(filePaths.size());
+
+	for (std::size_t i = 0; i < filePaths.size(); ++i)
+	{
+		auto& result = results[i];
+		result.filePath = filePaths[i];
+
+		futures.push_back(m_pool.Submit([&result, &process, combineStates, onlyOutput, streamFrames]()
+			{
+				try
+				{
+					result.fsm = std::make_unique<FiniteStateMachine>(result.filePath, combineStates, onlyOutput, streamFrames);
+					if (process)
+						process(result.filePath, *result.fsm);
+				}
+				catch (const std::exception& e)
+				{
+					result.error = e.what();
+				}
+			}
+		));
+	}
+
+	for (auto& future : futures)
+		future.wait();
+
+	return results;
+}
+
+unsigned int BatchBuilder::GetThreadCount() const
+{
+	return m_pool.GetThreadCount();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "FiniteStateMachine.h"
+#include "ThreadPool.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct BatchResult
+{
+	std::string filePath;
+	// Null, if the log could not be read
+	std::unique_ptr<FiniteStateMachine> fsm;
+	std::string error;
+};
+
+/// <summary>
+/// Builds the machines of many logs in parallel.
+/// Every machine owns its registry, so the workers share no state.
+/// </summary>
+class BatchBuilder
+{
+public:
+	/// <summary>
+	/// Runs on the worker after the machine is built, e.g. to apply the passes and write the results
+	/// </summary>
+	using ProcessFunction = std::function<void(const std::string& filePath, FiniteStateMachine& fsm)>;
+
+public:
+	/// <summary>
+	/// 0 threads uses one per hardware thread
+	/// </summary>
+	explicit BatchBuilder(unsigned int threadCount = 0);
+
+public:
+	/// <summary>
+	/// Builds one machine per log, the results are in the order of the paths
+	/// </summary>
+	std::vector<BatchResult> Build(
+		const std::vector<std::string>& filePaths,
+		bool combineStates = true,
+		bool onlyOutput = false,
+		bool streamFrames = false,
+		const ProcessFunction& process = nullptr
+	);
+
+	unsigned int GetThreadCount() const;
+
+private:
+	ThreadPool m_pool;
+};
@@ -0,0 +1,343 @@
+#include "BenchmarkSuite.h"
+#include "Condensation.h"
+#include "FiniteStateMachine.h"
+#include "SyntheticFrameSource.h"
+#include "ImageKernels.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+namespace
+{
+	// Every allocation starts with its size, the header keeps the alignment of operator new
+	constexpr std::size_t HeaderSize = alignof(std::max_align_t);
+	// Bounds the repetitions of very fast benchmarks
+	constexpr uint64_t MaxIterations = 1000000;
+	// Bounds the repetitions of fast passes behind a slow set up, relative to the minimum time
+	constexpr double MaxTimeFactor = 4;
+
+	std::atomic<uint64_t> allocationCount = 0;
+	std::atomic<uint64_t> allocatedBytes = 0;
+	std::atomic<uint64_t> liveBytes = 0;
+	std::atomic<uint64_t> peakBytes = 0;
+
+	std::string FormatTime(double nanoseconds)
+	{
+		std::ostringstream stream;
+		stream << std::fixed << std::setprecision(2);
+		if (nanoseconds >= 1e9)
+			stream << nanoseconds * 1e-9 << " s";
+		else if (nanoseconds >= 1e6)
+			stream << nanoseconds * 1e-6 << " ms";
+		else if (nanoseconds >= 1e3)
+			stream << nanoseconds * 1e-3 << " us";
+		else
+			stream << nanoseconds << " ns";
+		return stream.str();
+	}
+}
+
+BenchmarkSuite::BenchmarkSuite(double minTime /*= 0.5*/)
+	: m_minTime(minTime)
+{
+}
+
+std::string BenchmarkSuite::AddLog(const std::string& filePath)
+{
+	auto log = std::make_unique<Log>();
+	log->name = std::filesystem::path(filePath).filename().string();
+	log->filePath = filePath;
+
+	std::string error;
+	try
+	{
+		auto source = FrameSource::Open(filePath);
+		bool success = source->ReadFrames([&log](std::span<const Frame> frames)
+			{
+				for (auto& frame : frames)
+					log->frames.AddFrame(frame.timestamp, frame.isInput, frame.changes);
+				log->frameCount += frames.size();
+			});
+		if (!success)
+			error = source->GetError();
+	}
+	catch (const std::exception& e)
+	{
+		error = e.what();
+	}
+
+	if (error.empty() && log->frameCount == 0)
+		error = "The log has no frames";
+
+	if (error.empty())
+		m_logs.push_back(std::move(log));
+
+	return error;
+}
+
+void BenchmarkSuite::AddSyntheticLog(uint64_t frameCount)
+{
+	auto log = std::make_unique<Log>();
+	log->name = "synthetic-" + std::to_string(frameCount);
+
+	SyntheticFrameSource source(frameCount);
+	source.ReadFrames([&log](std::span<const Frame> frames)
+		{
+			for (auto& frame : frames)
+				log->frames.AddFrame(frame.timestamp, frame.isInput, frame.changes);
+			log->frameCount += frames.size();
+		});
+
+	m_logs.push_back(std::move(log));
+}
+
+void BenchmarkSuite::Run(const std::string& filter /*= ""*/)
+{
+	for (auto& log : m_logs)
+		RunLog(*log, filter);
+}
+
+void BenchmarkSuite::RunLog(Log& log, const std::string& filter)
+{
+	auto isSelected = [&filter, &log](const std::string& name)
+	{
+		return (name + "/" + log.name).find(filter) != std::string::npos;
+	};
+
+	std::unique_ptr<FiniteStateMachine> machine;
+	auto buildMachine = [&machine, &log]()
+	{
+		machine.reset();
+		machine = std::make_unique<FiniteStateMachine>(log.frames);
+	};
+
+	if (isSelected("Load"))
+	{
+		// Parsing of the file, the synthetic logs generate their frames instead
+		Measure("Load/" + log.name, nullptr, [&log]()
+			{
+				std::unique_ptr<FrameSource> source = log.filePath.empty()
+					? std::make_unique<SyntheticFrameSource>(log.frameCount)
+					: FrameSource::Open(log.filePath);
+
+				uint64_t frameCount = 0;
+				source->ReadFrames([&frameCount](std::span<const Frame> frames) { frameCount += frames.size(); });
+			},
+			log.frameCount);
+	}
+
+	if (isSelected("AddState"))
+		Measure("AddState/" + log.name, [&machine]() { machine.reset(); }, buildMachine, log.frameCount);
+
+	// Every pass starts on the machine as it was learned
+	struct Pass
+	{
+		const char* name;
+		std::function<void(FiniteStateMachine&)> run;
+	};
+
+	std::vector<Pass> passes = {
+		{ "CombineSequences", [](FiniteStateMachine& fsm) { fsm.CombineSequences(); } },
+		{ "RemoveInputStates", [](FiniteStateMachine& fsm) { fsm.RemoveInputStates(); } },
+		{ "Condensation", [](FiniteStateMachine& fsm) { Condensation condensation(fsm.GetGraph()); } },
+		{ "CombineSCC", [](FiniteStateMachine& fsm) { fsm.CombineSCC(); } },
+		{ "MergeCircuits", [](FiniteStateMachine& fsm) { fsm.MergeCircuits(); } },
+		{ "RenumberStates", [](FiniteStateMachine& fsm) { fsm.RenumberStates(); } },
+		{ "RelativeTimes", [](FiniteStateMachine& fsm) { fsm.RelativeTimes(); } },
+		{ "CutToPart", [](FiniteStateMachine& fsm) { fsm.CutToPart(0, fsm.GetStateCount() / 2, true); } }
+	};
+
+	for (auto& pass : passes)
+		if (isSelected(pass.name))
+			Measure(std::string(pass.name) + "/" + log.name, buildMachine, [&machine, &pass]() { pass.run(*machine); });
+
+	// The exporters print the machine main prints, after the sequences are combined
+	std::vector<Pass> exporters = {
+		{ "PrintTimes", [](FiniteStateMachine& fsm) { fsm.PrintTimes(); } },
+		{ "PrintTimeAutomata", [](FiniteStateMachine& fsm) { fsm.PrintTimeAutomata(0, 0, "q"); } },
+		{ "PrintRightLinearGrammar", [](FiniteStateMachine& fsm) { fsm.PrintRightLinearGrammar(0, 0, "q", "y"); } },
+		{ "PrintRegularAutomota", [](FiniteStateMachine& fsm) { fsm.PrintRegularAutomota(0, 0, "q", "t"); } }
+	};
+
+	bool isPrepared = false;
+	for (auto& exporter : exporters)
+	{
+		if (!isSelected(exporter.name))
+			continue;
+
+		if (!isPrepared)
+		{
+			buildMachine();
+			machine->CombineSequences();
+			machine->RenumberStates();
+			isPrepared = true;
+		}
+
+		Measure(std::string(exporter.name) + "/" + log.name, nullptr, [&machine, &exporter]() { exporter.run(*machine); });
+	}
+}
+
+void BenchmarkSuite::Measure(const std::string& name, const std::function<void()>& setUp, const std::function<void()>& body, uint64_t itemCount /*= 0*/)
+{
+	Result result;
+	result.name = name;
+
+	double realSeconds = 0;
+	double cpuSeconds = 0;
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+
+	auto loopStart = std::chrono::steady_clock::now();
+	auto isDone = [&]()
+	{
+		double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loopStart).count();
+		return realSeconds >= m_minTime || totalSeconds >= MaxTimeFactor * m_minTime || result.iterations >= MaxIterations;
+	};
+
+	do
+	{
+		if (setUp)
+			setUp();
+
+		auto allocationsBefore = allocationCount.load();
+		auto bytesBefore = allocatedBytes.load();
+		auto liveBefore = liveBytes.load();
+		peakBytes = liveBefore;
+
+		auto cpuStart = std::clock();
+		auto start = std::chrono::steady_clock::now();
+
+		body();
+
+		realSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		cpuSeconds += static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+		allocations += allocationCount.load() - allocationsBefore;
+		bytes += allocatedBytes.load() - bytesBefore;
+		result.peakBytes = std::max(result.peakBytes, peakBytes.load() - liveBefore);
+
+		++result.iterations;
+	} while (!isDone());
+
+	result.realTime = realSeconds * 1e9 / result.iterations;
+	result.cpuTime = cpuSeconds * 1e9 / result.iterations;
+	result.allocations = allocations / result.iterations;
+	result.allocatedBytes = bytes / result.iterations;
+	if (itemCount != 0)
+		result.itemsPerSecond = itemCount * result.iterations / realSeconds;
+
+	m_results.push_back(result);
+}
+
+const std::vector<BenchmarkSuite::Result>& BenchmarkSuite::GetResults() const
+{
+	return m_results;
+}
+
+std::string BenchmarkSuite::PrintTable() const
+{
+	std::ostringstream stream;
+	stream << std::left << std::setw(48) << "Benchmark" << std::right
+		<< std::setw(14) << "Time" << std::setw(14) << "CPU" << std::setw(12) << "Iterations"
+		<< std::setw(14) << "Allocations" << std::setw(16) << "Allocated" << std::setw(16) << "Peak"
+		<< std::setw(16) << "Frames/s" << "\n";
+
+	for (auto& result : m_results)
+	{
+		stream << std::left << std::setw(48) << result.name << std::right
+			<< std::setw(14) << FormatTime(result.realTime) << std::setw(14) << FormatTime(result.cpuTime)
+			<< std::setw(12) << result.iterations << std::setw(14) << result.allocations
+			<< std::setw(16) << result.allocatedBytes << std::setw(16) << result.peakBytes
+			<< std::setw(16) << (result.itemsPerSecond != 0 ? std::to_string(static_cast<uint64_t>(result.itemsPerSecond)) : "") << "\n";
+	}
+
+	return stream.str();
+}
+
+void BenchmarkSuite::WriteJson(const std::string& filePath) const
+{
+	auto now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+	nlohmann::ordered_json document;
+	document["context"] = {
+		{ "date", date },
+		{ "num_cpus", std::thread::hardware_concurrency() },
+#ifdef NDEBUG
+		{ "library_build_type", "release" },
+#else
+		{ "library_build_type", "debug" },
+#endif
+		{ "image_kernels", ImageKernels::GetLevelName(ImageKernels::GetLevel()) }
+	};
+
+	auto& benchmarks = document["benchmarks"] = nlohmann::ordered_json::array();
+	for (auto& result : m_results)
+	{
+		nlohmann::ordered_json benchmark = {
+			{ "name", result.name },
+			{ "run_name", result.name },
+			{ "run_type", "iteration" },
+			{ "repetitions", 1 },
+			{ "repetition_index", 0 },
+			{ "threads", 1 },
+			{ "iterations", result.iterations },
+			{ "real_time", result.realTime },
+			{ "cpu_time", result.cpuTime },
+			{ "time_unit", "ns" },
+			{ "allocations", result.allocations },
+			{ "allocated_bytes", result.allocatedBytes },
+			{ "peak_bytes", result.peakBytes }
+		};
+		if (result.itemsPerSecond != 0)
+			benchmark["items_per_second"] = result.itemsPerSecond;
+
+		benchmarks.push_back(benchmark);
+	}
+
+	std::ofstream file(filePath);
+	file << document.dump(2) << std::endl;
+}
+
+void* BenchmarkSuite::Allocate(std::size_t byteCount)
+{
+	auto base = static_cast<unsigned char*>(std::malloc(byteCount + HeaderSize));
+	if (!base)
+		throw std::bad_alloc();
+
+	memcpy(base, &byteCount, sizeof(byteCount));
+
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(byteCount, std::memory_order_relaxed);
+
+	auto live = liveBytes.fetch_add(byteCount, std::memory_order_relaxed) + byteCount;
+	auto peak = peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+	{
+	}
+
+	return base + HeaderSize;
+}
+
+void BenchmarkSuite::Free(void* pointer) noexcept
+{
+	if (!pointer)
+		return;
+
+	auto base = static_cast<unsigned char*>(pointer) - HeaderSize;
+
+	std::size_t byteCount;
+	memcpy(&byteCount, base, sizeof(byteCount));
+	liveBytes.fetch_sub(byteCount, std::memory_order_relaxed);
+
+	std::free(base);
+}
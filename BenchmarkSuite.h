@@ -0,0 +1,90 @@
+#pragma once
+#include "FrameSource.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Measures the ingestion and every pass and exporter of the machine on a set of logs.
+/// Every benchmark reports the time, the allocations and the peak heap memory of one iteration.
+/// The results are written in the JSON format of Google Benchmark, so its tools can compare two commits.
+/// </summary>
+class BenchmarkSuite
+{
+public:
+	struct Result
+	{
+		std::string name;
+		uint64_t iterations = 0;
+		// Per iteration, in nanoseconds
+		double realTime = 0;
+		double cpuTime = 0;
+		// Per iteration, only counted if the heap is routed through Allocate and Free
+		uint64_t allocations = 0;
+		uint64_t allocatedBytes = 0;
+		// Highest heap usage of an iteration above the usage before it
+		uint64_t peakBytes = 0;
+		// Frames per second, 0 for benchmarks, that do not read frames
+		double itemsPerSecond = 0;
+	};
+
+public:
+	/// <param name="minTime">Seconds every benchmark is repeated for at least</param>
+	explicit BenchmarkSuite(double minTime = 0.5);
+
+	/// <summary>
+	/// Adds a log file, its frames are read into memory once
+	/// </summary>
+	/// <returns>The error, if the file is no frame log, which is skipped then</returns>
+	std::string AddLog(const std::string& filePath);
+
+	/// <summary>
+	/// Adds a log of the synthetic process, to scale the input beyond the recorded logs
+	/// </summary>
+	void AddSyntheticLog(uint64_t frameCount);
+
+	/// <summary>
+	/// Runs every benchmark, whose name contains the filter
+	/// </summary>
+	void Run(const std::string& filter = "");
+
+	const std::vector<Result>& GetResults() const;
+
+	std::string PrintTable() const;
+
+	/// <summary>
+	/// Writes the results in the JSON format of Google Benchmark
+	/// </summary>
+	void WriteJson(const std::string& filePath) const;
+
+	/// <summary>
+	/// Heap accounting for the global operator new and delete of a benchmark binary.
+	/// Without them the allocation columns stay 0.
+	/// </summary>
+	static void* Allocate(std::size_t byteCount);
+	static void Free(void* pointer) noexcept;
+
+private:
+	struct Log
+	{
+		std::string name;
+		// Empty for synthetic logs
+		std::string filePath;
+		uint64_t frameCount = 0;
+		MemoryFrameSource frames;
+	};
+
+	void RunLog(Log& log, const std::string& filter);
+
+	/// <summary>
+	/// Repeats the body until the minimum time is reached. The set up before every iteration is not measured.
+	/// </summary>
+	void Measure(const std::string& name, const std::function<void()>& setUp, const std::function<void()>& body, uint64_t itemCount = 0);
+
+private:
+	double m_minTime;
+	std::vector<std::unique_ptr<Log>> m_logs;
+	std::vector<Result> m_results;
+};
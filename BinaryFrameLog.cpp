@@ -0,0 +1,284 @@
+#include "BinaryFrameLog.h"
+#include "JsonFrameReader.h"
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <string>
+
+bool BinaryFrameLog::IsBinaryLog(const std::string& filePath)
+{
+	std::ifstream f(filePath, std::ios::binary);
+	char magic[sizeof(Magic)] = {};
+	f.read(magic, sizeof(magic));
+	return f.gcount() == sizeof(magic) && memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+bool BinaryFrameLog::ConvertFromJson(const std::string& jsonPath, const std::string& binaryPath, std::string* error /*= nullptr*/)
+{
+	BinaryFrameWriter writer(binaryPath);
+	if (!writer.IsOpen())
+	{
+		if (error)
+			*error = "Could not open " + binaryPath;
+		return false;
+	}
+
+	// The log ends before the first frame it cannot hold
+	bool isWritten = true;
+	JsonFrameReader reader(jsonPath);
+	bool success = reader.ReadFrames(
+		[&writer, &isWritten](const uint64_t& timestamp, bool isInput, const std::vector<Change>& changes)
+		{
+			isWritten = isWritten && writer.WriteFrame(timestamp, isInput, changes);
+		}
+	);
+	writer.Close();
+
+	if (!success && error)
+		*error = reader.GetError();
+	else if (!isWritten && error)
+		*error = writer.GetError();
+
+	return success && isWritten;
+}
+
+BinaryFrameWriter::BinaryFrameWriter(const std::string& filePath)
+	: m_file(filePath, std::ios::binary | std::ios::trunc)
+{
+	if (!m_file.is_open())
+		return;
+
+	BinaryFrameLog::FileHeader header = {};
+	memcpy(header.magic, BinaryFrameLog::Magic, sizeof(header.magic));
+	header.version = BinaryFrameLog::Version;
+	header.headerSize = sizeof(header);
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+BinaryFrameWriter::~BinaryFrameWriter()
+{
+	Close();
+}
+
+bool BinaryFrameWriter::IsOpen() const
+{
+	return m_file.is_open();
+}
+
+bool BinaryFrameWriter::WriteFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes)
+{
+	if (!m_file.is_open())
+	{
+		m_error = "The binary frame log is not open";
+		return false;
+	}
+
+	// The counts are stored in 16 bits, a truncated count would not match the bytes of the record
+	if (changes.size() > UINT16_MAX)
+	{
+		m_error = "The frame at " + std::to_string(timestamp) + " has more than " + std::to_string(UINT16_MAX) + " changes";
+		return false;
+	}
+
+	uint64_t recordSize = sizeof(BinaryFrameLog::FrameHeader);
+	for (auto& change : changes)
+	{
+		if (change.byteCount > UINT16_MAX)
+		{
+			m_error = "Participant " + std::to_string(change.participantId) + " of the frame at " + std::to_string(timestamp)
+				+ " has more than " + std::to_string(UINT16_MAX) + " bytes";
+			return false;
+		}
+		recordSize += sizeof(BinaryFrameLog::ChangeHeader) + change.byteCount;
+	}
+
+	if (recordSize + BinaryFrameLog::RecordAlignment > UINT32_MAX)
+	{
+		m_error = "The frame at " + std::to_string(timestamp) + " exceeds the record size";
+		return false;
+	}
+
+	auto padding = static_cast<uint32_t>((BinaryFrameLog::RecordAlignment - recordSize % BinaryFrameLog::RecordAlignment) % BinaryFrameLog::RecordAlignment);
+
+	BinaryFrameLog::FrameHeader frameHeader = {};
+	frameHeader.timestamp = timestamp;
+	frameHeader.recordSize = static_cast<uint32_t>(recordSize + padding);
+	frameHeader.changeCount = static_cast<uint16_t>(changes.size());
+	frameHeader.isInput = isInput ? 1 : 0;
+	m_file.write(reinterpret_cast<const char*>(&frameHeader), sizeof(frameHeader));
+
+	for (auto& change : changes)
+	{
+		BinaryFrameLog::ChangeHeader changeHeader = { change.participantId, static_cast<uint16_t>(change.byteCount) };
+		m_file.write(reinterpret_cast<const char*>(&changeHeader), sizeof(changeHeader));
+		m_file.write(reinterpret_cast<const char*>(change.bytes), change.byteCount);
+	}
+
+	const char zeros[BinaryFrameLog::RecordAlignment] = {};
+	m_file.write(zeros, padding);
+
+	++m_frameCount;
+	return true;
+}
+
+void BinaryFrameWriter::Close()
+{
+	if (!m_file.is_open())
+		return;
+
+	m_file.seekp(offsetof(BinaryFrameLog::FileHeader, frameCount));
+	m_file.write(reinterpret_cast<const char*>(&m_frameCount), sizeof(m_frameCount));
+	m_file.close();
+}
+
+const std::string& BinaryFrameWriter::GetError() const
+{
+	return m_error;
+}
+
+BinaryFrameReader::BinaryFrameReader(const std::string& filePath)
+	: m_file(filePath)
+	, m_filePath(filePath)
+{
+}
+
+bool BinaryFrameReader::ReadFrames(const FrameCallback& onFrame)
+{
+	BinaryFrameLog::FileHeader fileHeader;
+	if (!ReadFileHeader(fileHeader))
+		return false;
+
+	return ReadFrames(onFrame, { fileHeader.headerSize, 0, fileHeader.frameCount });
+}
+
+bool BinaryFrameReader::ReadFrames(const FrameCallback& onFrame, const FrameChunk& chunk)
+{
+	if (!m_file.IsOpen())
+	{
+		m_error = "Could not map " + m_filePath;
+		return false;
+	}
+
+	const unsigned char* data = m_file.GetData();
+
+	// The change vector is reused, so no frame allocates
+	std::vector<Change> changes;
+	std::size_t offset = chunk.offset;
+
+	for (uint64_t frame = chunk.firstFrame; frame < chunk.firstFrame + chunk.frameCount; ++frame)
+	{
+		BinaryFrameLog::FrameHeader frameHeader;
+		if (!ReadFrameHeader(offset, frame, frameHeader))
+			return false;
+
+		const std::size_t recordEnd = offset + frameHeader.recordSize;
+
+		changes.clear();
+		std::size_t position = offset + sizeof(frameHeader);
+
+		for (uint16_t i = 0; i < frameHeader.changeCount; ++i)
+		{
+			BinaryFrameLog::ChangeHeader changeHeader;
+			if (position + sizeof(changeHeader) > recordEnd)
+				break;
+
+			memcpy(&changeHeader, data + position, sizeof(changeHeader));
+			position += sizeof(changeHeader);
+
+			if (position + changeHeader.byteCount > recordEnd)
+				break;
+
+			changes.push_back({ changeHeader.participantId, changeHeader.byteCount, data + position });
+			position += changeHeader.byteCount;
+		}
+
+		if (changes.size() != frameHeader.changeCount)
+		{
+			m_error = m_filePath + " has a corrupt record at frame " + std::to_string(frame);
+			return false;
+		}
+
+		onFrame(frameHeader.timestamp, frameHeader.isInput != 0, changes);
+		offset = recordEnd;
+	}
+
+	return true;
+}
+
+bool BinaryFrameReader::SplitFrames(std::size_t chunkCount, std::vector<FrameChunk>& chunks)
+{
+	chunks.clear();
+
+	BinaryFrameLog::FileHeader fileHeader;
+	if (!ReadFileHeader(fileHeader))
+		return false;
+
+	chunkCount = std::max<std::size_t>(1, chunkCount);
+	const uint64_t framesPerChunk = (fileHeader.frameCount + chunkCount - 1) / chunkCount;
+	std::size_t offset = fileHeader.headerSize;
+
+	for (uint64_t frame = 0; frame < fileHeader.frameCount; ++frame)
+	{
+		if (frame % framesPerChunk == 0)
+			chunks.push_back({ offset, frame, 0 });
+
+		BinaryFrameLog::FrameHeader frameHeader;
+		if (!ReadFrameHeader(offset, frame, frameHeader))
+			return false;
+
+		++chunks.back().frameCount;
+		offset += frameHeader.recordSize;
+	}
+
+	return true;
+}
+
+bool BinaryFrameReader::ReadFileHeader(BinaryFrameLog::FileHeader& fileHeader)
+{
+	if (!m_file.IsOpen())
+	{
+		m_error = "Could not map " + m_filePath;
+		return false;
+	}
+
+	if (m_file.GetSize() < sizeof(fileHeader))
+	{
+		m_error = m_filePath + " is too small for a binary frame log";
+		return false;
+	}
+
+	memcpy(&fileHeader, m_file.GetData(), sizeof(fileHeader));
+	if (memcmp(fileHeader.magic, BinaryFrameLog::Magic, sizeof(fileHeader.magic)) != 0
+		|| fileHeader.version != BinaryFrameLog::Version)
+	{
+		m_error = m_filePath + " is not a binary frame log of version " + std::to_string(BinaryFrameLog::Version);
+		return false;
+	}
+
+	return true;
+}
+
+bool BinaryFrameReader::ReadFrameHeader(std::size_t offset, uint64_t frame, BinaryFrameLog::FrameHeader& frameHeader)
+{
+	const std::size_t size = m_file.GetSize();
+
+	if (offset + sizeof(frameHeader) > size)
+	{
+		m_error = m_filePath + " is truncated at frame " + std::to_string(frame);
+		return false;
+	}
+
+	memcpy(&frameHeader, m_file.GetData() + offset, sizeof(frameHeader));
+	if (offset + frameHeader.recordSize > size || frameHeader.recordSize < sizeof(frameHeader))
+	{
+		m_error = m_filePath + " is truncated at frame " + std::to_string(frame);
+		return false;
+	}
+
+	return true;
+}
+
+const std::string& BinaryFrameReader::GetError() const
+{
+	return m_error;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+
+/// <summary>
+/// Compact binary representation of the frame logs (little endian).
+/// A file header is followed by one record per frame. A frame record is a frame header
+/// followed by a change header and the raw bytes for each change, padded to 8 bytes.
+/// </summary>
+namespace BinaryFrameLog
+{
+	constexpr char Magic[4] = { 'C', 'T', 'F', 'L' };
+	constexpr uint16_t Version = 1;
+	constexpr uint32_t RecordAlignment = 8;
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint16_t version;
+		uint16_t headerSize;
+		uint64_t frameCount;
+	};
+
+	struct FrameHeader
+	{
+		uint64_t timestamp;
+		uint32_t recordSize;
+		uint16_t changeCount;
+		uint8_t isInput;
+		uint8_t reserved;
+	};
+
+	struct ChangeHeader
+	{
+		uint16_t participantId;
+		uint16_t byteCount;
+	};
+
+	static_assert(sizeof(FileHeader) == 16 && sizeof(FrameHeader) == 16 && sizeof(ChangeHeader) == 4,
+		"The binary frame log headers must not be padded");
+
+	/// <summary>
+	/// Checks the magic number of the file
+	/// </summary>
+	bool IsBinaryLog(const std::string& filePath);
+
+	/// <summary>
+	/// One time conversion of a JSON event log, the JSON file is streamed
+	/// </summary>
+	bool ConvertFromJson(const std::string& jsonPath, const std::string& binaryPath, std::string* error = nullptr);
+}
+
+/// <summary>
+/// Writes frames into a binary frame log
+/// </summary>
+class BinaryFrameWriter
+{
+public:
+	explicit BinaryFrameWriter(const std::string& filePath);
+	~BinaryFrameWriter();
+
+	BinaryFrameWriter(const BinaryFrameWriter& other) = delete;
+	void operator=(const BinaryFrameWriter&) = delete;
+
+public:
+	bool IsOpen() const;
+
+	/// <summary>
+	/// Appends the record of the frame
+	/// </summary>
+	/// <returns>false, if the log is not open or the frame exceeds the header fields, nothing is written then</returns>
+	bool WriteFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes);
+
+	/// <summary>
+	/// Writes the final frame count into the file header
+	/// </summary>
+	void Close();
+
+	const std::string& GetError() const;
+
+private:
+	std::ofstream m_file;
+	std::string m_error;
+	uint64_t m_frameCount = 0;
+};
+
+/// <summary>
+/// Consecutive frames of a binary frame log
+/// </summary>
+struct FrameChunk
+{
+	// Offset of the first frame record in the file
+	std::size_t offset = 0;
+	uint64_t firstFrame = 0;
+	uint64_t frameCount = 0;
+};
+
+/// <summary>
+/// Reads a binary frame log from a memory mapping.
+/// The bytes of the changes point directly into the mapping.
+/// </summary>
+class BinaryFrameReader
+{
+public:
+	explicit BinaryFrameReader(const std::string& filePath);
+
+	/// <summary>
+	/// Calls onFrame for every frame in the log
+	/// </summary>
+	/// <returns>false, if the file could not be mapped or is corrupt</returns>
+	bool ReadFrames(const FrameCallback& onFrame);
+
+	/// <summary>
+	/// Calls onFrame for the frames of one chunk
+	/// </summary>
+	bool ReadFrames(const FrameCallback& onFrame, const FrameChunk& chunk);
+
+	/// <summary>
+	/// Walks the frame headers and splits the log into chunks of about the same number of frames
+	/// </summary>
+	bool SplitFrames(std::size_t chunkCount, std::vector<FrameChunk>& chunks);
+
+	const std::string& GetError() const;
+
+private:
+	bool ReadFileHeader(BinaryFrameLog::FileHeader& fileHeader);
+
+	/// <summary>
+	/// Checks the size of the frame record at the offset
+	/// </summary>
+	bool ReadFrameHeader(std::size_t offset, uint64_t frame, BinaryFrameLog::FrameHeader& frameHeader);
+
+private:
+	MappedFile m_file;
+	std::string m_filePath;
+	std::string m_error;
+};
@@ -0,0 +1,259 @@
+#include "Condensation.h"
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	constexpr uint32_t Unvisited = UINT32_MAX;
+
+	// Stable counting sort of the items by a key below keyCount
+	template<class Item, class Key>
+	void SortByKey(std::vector<Item>& items, uint32_t keyCount, Key key)
+	{
+		std::vector<std::size_t> offsets(keyCount + 1, 0);
+		for (auto& item : items)
+			++offsets[key(item) + 1];
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+		std::vector<Item> sorted(items.size());
+		for (auto& item : items)
+			sorted[offsets[key(item)]++] = item;
+		items.swap(sorted);
+	}
+}
+
+Condensation::Condensation(const StateGraph& graph)
+{
+	FindComponents(graph);
+	BuildEdges(graph);
+}
+
+void Condensation::FindComponents(const StateGraph& graph)
+{
+	auto stateCount = graph.GetStateCount();
+	m_components.assign(stateCount, NoComponent);
+
+	// The order every state was reached in and the lowest order reachable from it
+	std::vector<uint32_t> order(stateCount, Unvisited);
+	std::vector<uint32_t> lowlink(stateCount, 0);
+	uint32_t nextOrder = 0;
+
+	// The states of the components that are not complete yet
+	std::vector<uint32_t> openStates;
+
+	// The path of the depth first search, with the next transition of every state on it
+	struct PathState
+	{
+		uint32_t state;
+		uint32_t transition;
+	};
+	std::vector<PathState> path;
+
+	auto visit = [&](uint32_t state)
+	{
+		order[state] = lowlink[state] = nextOrder++;
+		openStates.push_back(state);
+		path.push_back({ state, graph.TransitionsBegin(state) });
+	};
+
+	for (uint32_t root = 0; root < stateCount; ++root)
+	{
+		if (order[root] != Unvisited)
+			continue;
+
+		visit(root);
+		while (!path.empty())
+		{
+			auto state = path.back().state;
+			auto transition = path.back().transition;
+
+			if (transition != graph.TransitionsEnd(state))
+			{
+				++path.back().transition;
+
+				auto target = graph.GetTarget(transition);
+				if (order[target] == Unvisited)
+					visit(target);
+				// Without a component the target is still open, so it is part of the path's component
+				else if (m_components[target] == NoComponent)
+					lowlink[state] = std::min(lowlink[state], order[target]);
+				continue;
+			}
+
+			path.pop_back();
+			if (!path.empty())
+				lowlink[path.back().state] = std::min(lowlink[path.back().state], lowlink[state]);
+
+			if (lowlink[state] != order[state])
+				continue;
+
+			// The state is the root of its component, all open states above it belong to it
+			uint32_t member;
+			do {
+				member = openStates.back();
+				openStates.pop_back();
+				m_components[member] = m_componentCount;
+			} while (member != state);
+			++m_componentCount;
+		}
+	}
+
+	// A component is complete after every component it reaches, reversed they are in topological order
+	for (auto& component : m_components)
+		component = m_componentCount - 1 - component;
+
+	if (graph.GetStartState() != StateGraph::NoState)
+		m_startComponent = m_components[graph.GetStartState()];
+
+	// Counting sort of the states by their component, so the members stay ascending
+	m_memberOffsets.assign(m_componentCount + 1, 0);
+	for (auto component : m_components)
+		++m_memberOffsets[component + 1];
+	std::partial_sum(m_memberOffsets.begin(), m_memberOffsets.end(), m_memberOffsets.begin());
+
+	m_members.resize(stateCount);
+	auto next = m_memberOffsets;
+	for (uint32_t state = 0; state < stateCount; ++state)
+		m_members[next[m_components[state]]++] = state;
+}
+
+void Condensation::BuildEdges(const StateGraph& graph)
+{
+	m_internalTransitionCounts.assign(m_componentCount, 0);
+	m_internalStatistics.assign(m_componentCount, TimingStatistics());
+
+	struct Crossing
+	{
+		uint32_t source;
+		uint32_t target;
+		uint32_t transition;
+	};
+	std::vector<Crossing> crossings;
+	crossings.reserve(graph.GetTransitionCount());
+
+	for (uint32_t state = 0; state < graph.GetStateCount(); ++state)
+	{
+		auto source = m_components[state];
+		for (auto transition = graph.TransitionsBegin(state); transition != graph.TransitionsEnd(state); ++transition)
+		{
+			auto target = m_components[graph.GetTarget(transition)];
+			if (target == source)
+			{
+				++m_internalTransitionCounts[source];
+				m_internalStatistics[source].Merge(graph.GetStatistics(transition));
+			}
+			else
+				crossings.push_back({ source, target, transition });
+		}
+	}
+
+	// Sorted by source and target in linear time, so the transitions of every edge are adjacent
+	SortByKey(crossings, m_componentCount, [](const Crossing& crossing) { return crossing.target; });
+	SortByKey(crossings, m_componentCount, [](const Crossing& crossing) { return crossing.source; });
+
+	auto isNewEdge = [&crossings](std::size_t i)
+	{
+		return i == 0 || crossings[i].source != crossings[i - 1].source || crossings[i].target != crossings[i - 1].target;
+	};
+
+	m_edgeOffsets.assign(m_componentCount + 1, 0);
+	for (std::size_t i = 0; i < crossings.size(); ++i)
+		if (isNewEdge(i))
+			++m_edgeOffsets[crossings[i].source + 1];
+	std::partial_sum(m_edgeOffsets.begin(), m_edgeOffsets.end(), m_edgeOffsets.begin());
+
+	m_targets.resize(m_edgeOffsets.back());
+	m_transitionCounts.resize(m_edgeOffsets.back(), 0);
+	m_statistics.resize(m_edgeOffsets.back());
+
+	uint32_t edge = 0;
+	for (std::size_t i = 0; i < crossings.size(); ++i)
+	{
+		if (i != 0 && isNewEdge(i))
+			++edge;
+
+		m_targets[edge] = crossings[i].target;
+		++m_transitionCounts[edge];
+		m_statistics[edge].Merge(graph.GetStatistics(crossings[i].transition));
+	}
+}
+
+uint32_t Condensation::GetComponentCount() const
+{
+	return m_componentCount;
+}
+
+uint32_t Condensation::GetComponent(uint32_t state) const
+{
+	return m_components[state];
+}
+
+uint32_t Condensation::GetStartComponent() const
+{
+	return m_startComponent;
+}
+
+std::span<const uint32_t> Condensation::GetMembers(uint32_t component) const
+{
+	return std::span<const uint32_t>(m_members.data() + m_memberOffsets[component], m_memberOffsets[component + 1] - m_memberOffsets[component]);
+}
+
+bool Condensation::IsCyclic(uint32_t component) const
+{
+	// A component of several states has at least two transitions inside of it
+	return m_internalTransitionCounts[component] != 0;
+}
+
+uint32_t Condensation::GetInternalTransitionCount(uint32_t component) const
+{
+	return m_internalTransitionCounts[component];
+}
+
+const TimingStatistics& Condensation::GetInternalStatistics(uint32_t component) const
+{
+	return m_internalStatistics[component];
+}
+
+uint32_t Condensation::GetEdgeCount() const
+{
+	return static_cast<uint32_t>(m_targets.size());
+}
+
+uint32_t Condensation::EdgesBegin(uint32_t component) const
+{
+	return m_edgeOffsets[component];
+}
+
+uint32_t Condensation::EdgesEnd(uint32_t component) const
+{
+	return m_edgeOffsets[component + 1];
+}
+
+uint32_t Condensation::GetTarget(uint32_t edge) const
+{
+	return m_targets[edge];
+}
+
+uint32_t Condensation::GetTransitionCount(uint32_t edge) const
+{
+	return m_transitionCounts[edge];
+}
+
+const TimingStatistics& Condensation::GetStatistics(uint32_t edge) const
+{
+	return m_statistics[edge];
+}
+
+std::size_t Condensation::GetByteCount() const
+{
+	std::size_t byteCount = sizeof(Condensation)
+		+ (m_components.capacity() + m_memberOffsets.capacity() + m_members.capacity() + m_internalTransitionCounts.capacity()
+			+ m_edgeOffsets.capacity() + m_targets.capacity() + m_transitionCounts.capacity()) * sizeof(uint32_t);
+
+	for (auto& statistics : m_internalStatistics)
+		byteCount += statistics.GetByteCount();
+	for (auto& statistics : m_statistics)
+		byteCount += statistics.GetByteCount();
+
+	return byteCount;
+}
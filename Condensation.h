@@ -0,0 +1,97 @@
+#pragma once
+#include "StateGraph.h"
+#include "TimingStatistics.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// <summary>
+/// Condensation of a state graph: every strongly connected component becomes one node, the nodes form a DAG.
+/// The components are found by an iterative Tarjan in O(states + transitions), the graph itself is not changed.
+/// The components are numbered in topological order, every edge leads to a higher component,
+/// so analyses can process the DAG in one pass over the components.
+/// The timing of a node and an edge merges the duration statistics of its transitions.
+/// </summary>
+class Condensation
+{
+public:
+	static constexpr uint32_t NoComponent = UINT32_MAX;
+
+public:
+	explicit Condensation(const StateGraph& graph);
+
+	uint32_t GetComponentCount() const;
+
+	/// <returns>The component of the state</returns>
+	uint32_t GetComponent(uint32_t state) const;
+
+	/// <returns>The component of the start state or NoComponent</returns>
+	uint32_t GetStartComponent() const;
+
+	/// <summary>
+	/// The states of the component in ascending order
+	/// </summary>
+	std::span<const uint32_t> GetMembers(uint32_t component) const;
+
+	/// <summary>
+	/// True, if the component holds a circuit: more than one state or a transition to itself
+	/// </summary>
+	bool IsCyclic(uint32_t component) const;
+
+	/// <summary>
+	/// Number of transitions between the states of the component
+	/// </summary>
+	uint32_t GetInternalTransitionCount(uint32_t component) const;
+
+	/// <summary>
+	/// The merged statistics of all transitions inside of the component
+	/// </summary>
+	const TimingStatistics& GetInternalStatistics(uint32_t component) const;
+
+	uint32_t GetEdgeCount() const;
+
+	/// <summary>
+	/// The edges of a component are [EdgesBegin, EdgesEnd), sorted by their target
+	/// </summary>
+	uint32_t EdgesBegin(uint32_t component) const;
+	uint32_t EdgesEnd(uint32_t component) const;
+
+	uint32_t GetTarget(uint32_t edge) const;
+
+	/// <summary>
+	/// Number of transitions the edge combines
+	/// </summary>
+	uint32_t GetTransitionCount(uint32_t edge) const;
+
+	/// <summary>
+	/// The merged statistics of all transitions between both components
+	/// </summary>
+	const TimingStatistics& GetStatistics(uint32_t edge) const;
+
+	/// <summary>
+	/// Memory of the components, the edges and their statistics
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+private:
+	void FindComponents(const StateGraph& graph);
+	void BuildEdges(const StateGraph& graph);
+
+private:
+	std::vector<uint32_t> m_components;
+	uint32_t m_componentCount = 0;
+	uint32_t m_startComponent = NoComponent;
+
+	// The members of all components in compressed rows
+	std::vector<uint32_t> m_memberOffsets;
+	std::vector<uint32_t> m_members;
+	std::vector<uint32_t> m_internalTransitionCounts;
+	std::vector<TimingStatistics> m_internalStatistics;
+
+	// The edges of the DAG in compressed rows
+	std::vector<uint32_t> m_edgeOffsets;
+	std::vector<uint32_t> m_targets;
+	std::vector<uint32_t> m_transitionCounts;
+	std::vector<TimingStatistics> m_statistics;
+};
@@ -1,268 +1,1120 @@
 #include "FiniteStateMachine.h"
+#include "BinaryFrameLog.h"
+#include "ThreadPool.h"
+#include "FrameSource.h"
+#include "SpscQueue.h"
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <future>
 #include <stack>
 #include <algorithm>
-#include <nlohmann/json.hpp>
+#include <numeric>
+#include <iomanip>
+#include <stdexcept>
 
-using json = nlohmann::json;
-
-FiniteStateMachine::FiniteStateMachine(const std::string& filePath, bool combineStates /*= true*/, bool onlyOutput /*= false*/)
+namespace
 {
-	std::weak_ptr<State> previousState;
-
-	std::ifstream f(filePath);
-	const json data = json::parse(f);
-	auto& frames = data["frames"];
+	/// <summary>
+	/// The last values written to every participant of one direction, by participant id.
+	/// Every change writes from the start of the participant, so the written bytes are a prefix.
+	/// </summary>
+	using ParticipantValues = std::map<unsigned short, std::vector<unsigned char>>;
 
-	for (auto& frame : frames)
+	void WriteValues(ParticipantValues& values, const std::vector<Change>& changes)
 	{
-		auto timestamp = frame["timestamp"].get<uint64_t>();
-		auto isInput = frame["input/output"].get<bool>();
+		for (auto& change : changes)
+		{
+			auto& bytes = values[change.participantId];
+			if (bytes.size() < change.byteCount)
+				bytes.resize(change.byteCount);
+			memcpy(bytes.data(), change.bytes, change.byteCount);
+		}
+	}
 
-		if (onlyOutput && isInput)
-			continue;
+	void WriteValues(ParticipantValues& values, const ParticipantValues& newValues)
+	{
+		for (auto& [participantId, newBytes] : newValues)
+		{
+			auto& bytes = values[participantId];
+			if (bytes.size() < newBytes.size())
+				bytes.resize(newBytes.size());
+			std::copy(newBytes.begin(), newBytes.end(), bytes.begin());
+		}
+	}
 
+	std::vector<Change> ToChanges(const ParticipantValues& values)
+	{
 		std::vector<Change> changes;
+		for (auto& [participantId, bytes] : values)
+			if (!bytes.empty())
+				changes.push_back({ participantId, static_cast<unsigned int>(bytes.size()), bytes.data() });
+		return changes;
+	}
+
+	std::vector<Change> CopyChanges(const std::vector<Change>& changes, std::vector<unsigned char>& bytes)
+	{
+		bytes.clear();
+		for (auto& change : changes)
+			bytes.insert(bytes.end(), change.bytes, change.bytes + change.byteCount);
 
-		for (auto& data : frame["data"])
+		std::vector<Change> copies = changes;
+		std::size_t offset = 0;
+		for (auto& change : copies)
 		{
-			unsigned int byteSize = data["byte"].size();
-			changes.push_back(
-				{
-					data["participant"].get<unsigned short>(),
-					byteSize
-				});
+			change.bytes = bytes.data() + offset;
+			offset += change.byteCount;
+		}
+		return copies;
+	}
 
-			unsigned int i = 0;
+	// Every chunk is finished before the first error unwinds the state the others still write to
+	void ThrowFirstError(std::vector<std::future<std::string>>& futures)
+	{
+		for (auto& future : futures)
+			future.wait();
 
-			for (auto& byte : data["byte"])
-				changes.back().bytes[i++] = byte.get<unsigned char>();
+		for (auto& future : futures)
+		{
+			auto error = future.get();
+			if (!error.empty())
+				throw std::runtime_error(error);
 		}
+	}
+
+	/// <summary>
+	/// What the first pass learns about a chunk of a binary log
+	/// </summary>
+	struct ChunkSummary
+	{
+		// Indexed by isInput
+		ParticipantValues values[2];
+		bool hasFirstFrame[2] = {};
+		uint64_t firstFrame[2] = {};
+		std::vector<Change> firstChanges[2];
+		std::vector<unsigned char> firstBytes[2];
+	};
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::BasicFiniteStateMachine(const std::string& filePath, bool combineStates /*= true*/, bool onlyOutput /*= false*/, bool streamFrames /*= false*/, unsigned int threadCount /*= 1*/,
+	const TimestampRetention& retention /*= {}*/)
+	: m_combineStates(combineStates)
+	, m_onlyOutput(onlyOutput)
+{
+	SetRetention(retention);
+
+	if (BinaryFrameLog::IsBinaryLog(filePath) && threadCount > 1)
+		ReadChunks(filePath, onlyOutput, combineStates, threadCount);
+	else
+	{
+		auto source = FrameSource::Open(filePath, streamFrames);
+		ReadSource(*source, onlyOutput, combineStates, threadCount);
+	}
+
+	FreezeGraph();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::BasicFiniteStateMachine(FrameSource& source, bool combineStates /*= true*/, bool onlyOutput /*= false*/, unsigned int threadCount /*= 1*/,
+	const TimestampRetention& retention /*= {}*/)
+	: m_combineStates(combineStates)
+	, m_onlyOutput(onlyOutput)
+{
+	SetRetention(retention);
+	ReadSource(source, onlyOutput, combineStates, threadCount);
+	FreezeGraph();
+}
 
-		AddState(previousState, timestamp, isInput, changes, combineStates);
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::ReadSource(FrameSource& source, bool onlyOutput, bool combineStates, unsigned int threadCount)
+{
+	if (threadCount > 1)
+	{
+		ReadPipelined(source, onlyOutput, combineStates);
+		return;
 	}
-	f.close();
+
+	bool success = source.ReadFrames([&](std::span<const Frame> frames)
+		{
+			for (auto& frame : frames)
+			{
+				if (onlyOutput && frame.isInput)
+					continue;
+
+				AddState(m_previousState, frame.timestamp, frame.isInput, frame.changes, combineStates);
+			}
+		});
+
+	if (!success)
+		throw std::runtime_error(source.GetError());
 }
 
-FiniteStateMachine::~FiniteStateMachine()
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::FreezeGraph()
 {
+	if (!m_isLearning)
+		return;
+
+	// The lazy trimming of the frames may have left a few more timestamps
+	if (!IsKeepingAllTimestamps())
+		m_builder.RetainTimestamps(m_timestampLimit, GetRetainedSince());
+
+	// The passes may renumber the states, the values find the previous state again
+	m_previousValueId = m_previousState != StateGraph::NoState ? m_builder.GetState(m_previousState).valueId : ValueRegistry::NoState;
+
+	// All states are known, so the transitions are packed for the passes
+	m_graph = m_builder.Freeze();
+	m_statesByValue.clear();
+	m_statesByValue.shrink_to_fit();
+	m_trace.ShrinkToFit();
+	m_isLearning = false;
 }
 
-void FiniteStateMachine::AddState(std::weak_ptr<State>& prevState, const uint64_t& timestamp, bool isInput, const std::vector<Change>& changes, bool combineStatesWithDuplicateValues)
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::ThawGraph()
 {
-	auto stateValues = StateValuesRegistry::GetStateValues(isInput, changes);
-	if (stateValues.empty())
+	if (m_isLearning)
+		return;
+
+	m_builder = StateGraphBuilder(std::move(m_graph));
+	m_isLearning = true;
+
+	// The passes changed the graph since the last check
+	if (m_retention.memoryBudget != 0)
+		EnforceMemoryBudget();
+
+	if (m_combineStates)
+	{
+		for (uint32_t state = 0; state < m_builder.GetStateCount(); ++state)
+		{
+			auto valueId = m_builder.GetState(state).valueId;
+			if (valueId >= m_statesByValue.size())
+				m_statesByValue.resize(valueId + 1, StateGraph::NoState);
+			if (m_statesByValue[valueId] == StateGraph::NoState)
+				m_statesByValue[valueId] = state;
+		}
+	}
+
+	if (m_previousState < m_builder.GetStateCount() && m_builder.GetState(m_previousState).valueId == m_previousValueId)
 		return;
-	if (!combineStatesWithDuplicateValues)
-		stateValues.push_back(std::make_shared<Participant>(1000, new unsigned char[1] {(unsigned char)m_stateContainer.size()}, 1, false));
 
-	auto state = std::make_shared<State>(stateValues, m_stateContainer.size());
+	m_previousState = m_previousValueId < m_statesByValue.size() ? m_statesByValue[m_previousValueId] : StateGraph::NoState;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::AddFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	if (!m_onlyOutput || !isInput)
+	{
+		ThawGraph();
+		AddState(m_previousState, timestamp, isInput, changes, m_combineStates);
+	}
+
+	uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	++m_frameLatency.frameCount;
+	m_frameLatency.totalNanoseconds += nanoseconds;
+	m_frameLatency.maxNanoseconds = std::max(m_frameLatency.maxNanoseconds, nanoseconds);
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::AddFrames(std::span<const Frame> frames)
+{
+	for (auto& frame : frames)
+		AddFrame(frame.timestamp, frame.isInput, frame.changes);
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+std::shared_ptr<const StateGraph> BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::PublishSnapshot()
+{
+	auto snapshot = std::make_shared<const StateGraph>(m_isLearning ? m_builder.Snapshot() : m_graph);
+
+	std::lock_guard<std::mutex> lock(m_snapshotMutex);
+	m_snapshot = snapshot;
+	return snapshot;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+std::shared_ptr<const StateGraph> BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetSnapshot() const
+{
+	std::lock_guard<std::mutex> lock(m_snapshotMutex);
+	return m_snapshot;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+const FrameLatency& BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetFrameLatency() const
+{
+	return m_frameLatency;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::~BasicFiniteStateMachine()
+{
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::AddState(uint32_t& prevState, const uint64_t& timestamp, bool isInput, std::span<const Change> changes, bool combineStatesWithDuplicateValues)
+{
+	++m_frameCount;
+	auto valueId = m_registry.GetStateValues(isInput, changes);
+	if (m_retention.memoryBudget != 0)
+		m_registryImageBytes = m_registry.GetImageByteCount();
+	AddStateValue(prevState, timestamp, valueId, combineStatesWithDuplicateValues);
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::AddStateValue(uint32_t& prevState, const uint64_t& timestamp, uint32_t valueId, bool combineStatesWithDuplicateValues)
+{
+	if (valueId == ValueRegistry::NoState)
+		return;
+
+	if constexpr (DuplicatePolicy::IsCounted)
+		m_registry.RecordHit(valueId, timestamp);
+
+	m_latestTimestamp = std::max(m_latestTimestamp, timestamp);
+
+	auto stateCount = m_builder.GetStateCount();
+	auto state = FindOrAddState(valueId, combineStatesWithDuplicateValues);
+	if (m_isTraceRecorded)
+		m_trace.Append(state, timestamp);
+
+	if (m_builder.GetStartState() == StateGraph::NoState)
+	{
+		m_builder.SetStartState(state);
+		prevState = state;
+		return;
+	}
+
+	// The previous state of online learning was removed by a pass
+	if (prevState == StateGraph::NoState)
+	{
+		prevState = state;
+		m_previousTimestamp = timestamp;
+		return;
+	}
+
+	auto& times = m_builder.GetTransitions(prevState)[state];
+
+	bool isNewTransition = times.statistics.GetCount() == 0;
+	if (isNewTransition)
+		++m_builder.GetState(state).indegree;
+
+	prevState = state;
+	auto duration = timestamp >= m_previousTimestamp ? timestamp - m_previousTimestamp : 0;
+	m_previousTimestamp = timestamp;
+
+	// Without timestamps nothing is left to drop for the budget
+	if (m_retention.memoryBudget == 0 || m_timestampLimit == 0)
+	{
+		AddTimestamp(times, timestamp, duration);
+		return;
+	}
+
+	// The growth of every frame is added to the bytes of the last check
+	auto transitionBytes = times.timestamps.capacity() * sizeof(uint64_t) + times.statistics.GetByteCount();
+	AddTimestamp(times, timestamp, duration);
+	m_budgetedBytes += times.timestamps.capacity() * sizeof(uint64_t) + times.statistics.GetByteCount() - transitionBytes
+		+ (isNewTransition ? StateGraphBuilder::TransitionByteCount : 0)
+		+ (m_builder.GetStateCount() - stateCount) * StateGraphBuilder::StateByteCount;
+
+	if (m_budgetedBytes + m_registryImageBytes + m_registry.GetHitByteCount() > m_retention.memoryBudget)
+		TrimToMemoryBudget();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::AddTimestamp(TransitionTimes& times, const uint64_t& timestamp, const uint64_t& duration)
+{
+	if (m_timestampLimit == 0)
+	{
+		times.statistics.Add(duration);
+		return;
+	}
+
+	InsertTimestamp(times, timestamp, duration);
+	TrimTimestamps(times);
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::TrimTimestamps(TransitionTimes& times)
+{
+	// Trimmed in steps of an eighth of the limit or the window, so a transition is not shifted for every frame
+	auto& timestamps = times.timestamps;
+	bool isOverLimit = timestamps.size() > m_timestampLimit + m_timestampLimit / 8 + 1;
+	bool isOutsideWindow = m_retention.mode == TimestampRetention::Mode::TimeWindow && !timestamps.empty()
+		&& timestamps.front() + m_retention.window + m_retention.window / 8 < m_latestTimestamp;
+
+	if (isOverLimit || isOutsideWindow)
+		RetainTimestamps(timestamps, m_timestampLimit, GetRetainedSince());
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+bool BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::IsKeepingAllTimestamps() const
+{
+	return m_timestampLimit == SIZE_MAX && m_retention.mode != TimestampRetention::Mode::TimeWindow;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetRetainedSince() const
+{
+	if (m_retention.mode != TimestampRetention::Mode::TimeWindow || m_latestTimestamp < m_retention.window)
+		return 0;
+	return m_latestTimestamp - m_retention.window;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::EnforceMemoryBudget()
+{
+	m_registryImageBytes = m_registry.GetImageByteCount();
+	TrimToMemoryBudget();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::TrimToMemoryBudget()
+{
+	// The hits are recorded on the same thread as the states
+	auto registryBytes = m_registryImageBytes + m_registry.GetHitByteCount();
+	auto budget = m_retention.memoryBudget;
+	auto usage = GetMemoryUsage(registryBytes).GetTotal();
+
+	// Trimmed below three quarters of the budget, so the next trim is many frames ahead
+	if (usage > budget)
+	{
+		while (usage > budget - budget / 4 && m_timestampLimit != 0)
+		{
+			// Every step halves the timestamps of the transitions that keep the most
+			m_timestampLimit = m_builder.RetainTimestamps(m_timestampLimit, GetRetainedSince()) / 2;
+			m_builder.RetainTimestamps(m_timestampLimit, GetRetainedSince());
+			usage = GetMemoryUsage(registryBytes).GetTotal();
+		}
+	}
+
+	m_budgetedBytes = usage - registryBytes;
+}
 
-	if (!m_startState)
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::SetRetention(const TimestampRetention& retention)
+{
+	m_retention = retention;
+	switch (retention.mode)
 	{
-		m_stateContainer.insert(state);
-		m_startState = state;
-		prevState = m_startState;
+	case TimestampRetention::Mode::LastCount:
+		m_timestampLimit = retention.count;
+		break;
+	case TimestampRetention::Mode::SummaryOnly:
+		m_timestampLimit = 0;
+		break;
+	default:
+		m_timestampLimit = SIZE_MAX;
+	}
+
+	if (IsKeepingAllTimestamps() && retention.memoryBudget == 0)
 		return;
+
+	// The trace grows with every frame, past the retention and the budget
+	DropTrace();
+
+	bool isLearning = m_isLearning;
+	ThawGraph();
+
+	m_builder.RetainTimestamps(m_timestampLimit, GetRetainedSince());
+	if (retention.memoryBudget != 0)
+		EnforceMemoryBudget();
+
+	if (!isLearning)
+		FreezeGraph();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+const TimestampRetention& BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetRetention() const
+{
+	return m_retention;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+MemoryUsage BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetMemoryUsage() const
+{
+	return GetMemoryUsage(m_registry.GetByteCount());
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+MemoryUsage BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetMemoryUsage(std::size_t registryBytes) const
+{
+	auto usage = m_isLearning ? m_builder.GetMemoryUsage() : m_graph.GetMemoryUsage();
+	usage.stateBytes += registryBytes + m_statesByValue.capacity() * sizeof(uint32_t);
+	usage.traceBytes = m_trace.GetByteCount();
+	return usage;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::ReadPipelined(FrameSource& source, bool onlyOutput, bool combineStates)
+{
+	// Enough batches in flight, that no stage waits for the one behind it
+	constexpr std::size_t BatchCount = 8;
+
+	std::vector<FrameBatch> batches(BatchCount);
+	SpscQueue<FrameBatch*> freeBatches(BatchCount);
+	SpscQueue<FrameBatch*> parsedBatches(BatchCount);
+	SpscQueue<FrameBatch*> resolvedBatches(BatchCount);
+
+	for (auto& batch : batches)
+		freeBatches.TryPush(&batch);
+
+	// A failing stage stops the others, its exception is rethrown by its future
+	auto stop = [&]()
+	{
+		freeBatches.Close();
+		parsedBatches.Close();
+		resolvedBatches.Close();
+	};
+
+	ThreadPool pool(2);
+
+	// Parse: the reader copies the frames into free batches
+	auto parsed = pool.Submit([&]()
+		{
+			try
+			{
+				FrameBatch* batch = nullptr;
+				bool isStopped = false;
+
+				bool success = source.ReadFrames([&](std::span<const Frame> frames)
+					{
+						for (auto& frame : frames)
+						{
+							if (isStopped || (onlyOutput && frame.isInput))
+								continue;
+
+							if (!batch && !freeBatches.Pop(batch))
+							{
+								isStopped = true;
+								return;
+							}
+
+							batch->Append(frame.timestamp, frame.isInput, frame.changes);
+
+							if (batch->IsFull())
+							{
+								batch->Complete();
+								isStopped = !parsedBatches.Push(batch);
+								batch = nullptr;
+							}
+						}
+					});
+
+				if (!success)
+					throw std::runtime_error(source.GetError());
+
+				if (batch)
+				{
+					batch->Complete();
+					parsedBatches.Push(batch);
+				}
+				parsedBatches.Close();
+			}
+			catch (...)
+			{
+				stop();
+				throw;
+			}
+		});
+
+	// Resolve: the registry interns the process images in frame order
+	auto resolved = pool.Submit([&]()
+		{
+			try
+			{
+				FrameBatch* batch = nullptr;
+
+				while (parsedBatches.Pop(batch))
+				{
+					auto frames = batch->GetFrames();
+					for (std::size_t frame = 0; frame < frames.size(); ++frame)
+						batch->SetValueId(frame, m_registry.GetStateValues(frames[frame].isInput, frames[frame].changes));
+					if (m_retention.memoryBudget != 0)
+						batch->SetRegistryByteCount(m_registry.GetImageByteCount());
+
+					if (!resolvedBatches.Push(batch))
+						break;
+				}
+				resolvedBatches.Close();
+			}
+			catch (...)
+			{
+				stop();
+				throw;
+			}
+		});
+
+	// Insert: the states and transitions are built on this thread
+	try
+	{
+		FrameBatch* batch = nullptr;
+
+		while (resolvedBatches.Pop(batch))
+		{
+			m_registryImageBytes = batch->GetRegistryByteCount();
+
+			auto frames = batch->GetFrames();
+			for (std::size_t frame = 0; frame < frames.size(); ++frame)
+			{
+				++m_frameCount;
+				AddStateValue(m_previousState, frames[frame].timestamp, batch->GetValueId(frame), combineStates);
+			}
+
+			batch->Clear();
+			freeBatches.Push(batch);
+		}
+	}
+	catch (...)
+	{
+		stop();
+		parsed.wait();
+		resolved.wait();
+		throw;
 	}
 
+	parsed.get();
+	resolved.get();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+uint32_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::FindOrAddState(uint32_t valueId, bool combineStatesWithDuplicateValues)
+{
 	// Search for the state values
-	if (combineStatesWithDuplicateValues)
-		state = *m_stateContainer.insert(state).first;
+	uint32_t state = StateGraph::NoState;
+	if (combineStatesWithDuplicateValues && valueId < m_statesByValue.size())
+		state = m_statesByValue[valueId];
+
+	if (state == StateGraph::NoState)
+	{
+		state = m_builder.AddState({ valueId, m_builder.GetStateCount() });
+
+		if (combineStatesWithDuplicateValues)
+		{
+			if (valueId >= m_statesByValue.size())
+				m_statesByValue.resize(valueId + 1, StateGraph::NoState);
+			m_statesByValue[valueId] = state;
+		}
+	}
+
+	return state;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::ReadChunks(const std::string& filePath, bool onlyOutput, bool combineStates, unsigned int threadCount)
+{
+	std::vector<FrameChunk> chunks;
+	{
+		BinaryFrameReader reader(filePath);
+		if (!reader.SplitFrames(threadCount, chunks))
+			throw std::runtime_error(reader.GetError());
+	}
+
+	ThreadPool pool(threadCount);
+
+	// First pass: the values every chunk leaves behind, so each chunk knows the process image it starts with
+	std::vector<ChunkSummary> summaries(chunks.size());
+	{
+		std::vector<std::future<std::string>> futures;
+		for (std::size_t i = 0; i < chunks.size(); ++i)
+		{
+			futures.push_back(pool.Submit([&filePath, &chunk = chunks[i], &summary = summaries[i], onlyOutput]()
+				{
+					uint64_t frame = chunk.firstFrame;
+					BinaryFrameReader reader(filePath);
+					bool success = reader.ReadFrames([&](const uint64_t&, bool isInput, const std::vector<Change>& changes)
+						{
+							auto currentFrame = frame++;
+							if (onlyOutput && isInput)
+								return;
+
+							if (!summary.hasFirstFrame[isInput])
+							{
+								summary.hasFirstFrame[isInput] = true;
+								summary.firstFrame[isInput] = currentFrame;
+								summary.firstChanges[isInput] = CopyChanges(changes, summary.firstBytes[isInput]);
+							}
+
+							WriteValues(summary.values[isInput], changes);
+						}, chunk);
+
+					return success ? std::string() : reader.GetError();
+				}
+			));
+		}
+
+		ThrowFirstError(futures);
+	}
+
+	// The first frame of each direction lays out its process image
+	const ChunkSummary* layouts[2] = {};
+	for (auto& summary : summaries)
+		for (int isInput = 0; isInput < 2; ++isInput)
+			if (!layouts[isInput] && summary.hasFirstFrame[isInput])
+				layouts[isInput] = &summary;
+
+	// The values before every chunk are the values of all previous chunks
+	std::vector<std::array<ParticipantValues, 2>> startValues(chunks.size());
+	for (std::size_t i = 1; i < chunks.size(); ++i)
+	{
+		startValues[i] = startValues[i - 1];
+		for (int isInput = 0; isInput < 2; ++isInput)
+			WriteValues(startValues[i][isInput], summaries[i - 1].values[isInput]);
+	}
+
+	// Second pass: every chunk is learned by its own machine
+	struct Shard
+	{
+		BasicFiniteStateMachine fsm;
+		uint32_t lastState = StateGraph::NoState;
+		uint64_t firstTimestamp = 0;
+	};
+
+	std::vector<std::unique_ptr<Shard>> shards(chunks.size());
+	{
+		std::vector<std::future<std::string>> futures;
+		for (std::size_t i = 0; i < chunks.size(); ++i)
+		{
+			futures.push_back(pool.Submit([&, i]()
+				{
+					auto shard = std::unique_ptr<Shard>(new Shard());
+					auto& chunk = chunks[i];
+
+					// The budget holds for the merged machine, the shards only keep the timestamps of the retention
+					auto retention = m_retention;
+					retention.memoryBudget = 0;
+					shard->fsm.SetRetention(retention);
+
+					for (int isInput = 0; isInput < 2; ++isInput)
+					{
+						auto layout = layouts[isInput];
+						if (layout && layout->firstFrame[isInput] < chunk.firstFrame)
+							shard->fsm.m_registry.Resume(isInput, layout->firstChanges[isInput], ToChanges(startValues[i][isInput]));
+					}
+
+					BinaryFrameReader reader(filePath);
+					bool success = reader.ReadFrames([&](const uint64_t& timestamp, bool isInput, const std::vector<Change>& changes)
+						{
+							if (onlyOutput && isInput)
+								return;
+
+							bool hasStart = shard->fsm.m_builder.GetStartState() != StateGraph::NoState;
+							shard->fsm.AddState(shard->lastState, timestamp, isInput, changes, combineStates);
+							if (!hasStart && shard->fsm.m_builder.GetStartState() != StateGraph::NoState)
+							{
+								shard->firstTimestamp = timestamp;
+								// Only the first chunk starts the run, the others enter their first state at its frame
+								if (i != 0)
+									shard->fsm.m_previousTimestamp = timestamp;
+							}
+						}, chunk);
+
+					shards[i] = std::move(shard);
+					return success ? std::string() : reader.GetError();
+				}
+			));
+		}
+
+		ThrowFirstError(futures);
+	}
+
+	for (auto& shard : shards)
+	{
+		MergeShard(shard->fsm, shard->lastState, shard->firstTimestamp, m_previousState, combineStates);
+		shard.reset();
+	}
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::MergeShard(BasicFiniteStateMachine& shard, uint32_t shardLastState, const uint64_t& firstTimestamp, uint32_t& previousState, bool combineStates)
+{
+	m_frameCount += shard.m_frameCount;
+	auto valueIds = m_registry.Merge(shard.m_registry);
+
+	auto& builder = shard.m_builder;
+	if (builder.GetStartState() == StateGraph::NoState)
+		return;
+
+	// The shard created its states in the order of their first frame
+	std::vector<uint32_t> states(builder.GetStateCount());
+	for (uint32_t state = 0; state < builder.GetStateCount(); ++state)
+		states[state] = FindOrAddState(valueIds[builder.GetState(state).valueId], combineStates);
+
+	auto addTransition = [this](uint32_t source, uint32_t target) -> TransitionTimes&
+	{
+		auto& times = m_builder.GetTransitions(source)[target];
+
+		if (times.statistics.GetCount() == 0)
+			++m_builder.GetState(target).indegree;
+
+		return times;
+	};
+
+	m_latestTimestamp = std::max(m_latestTimestamp, shard.m_latestTimestamp);
+
+	if (m_isTraceRecorded && shard.m_isTraceRecorded)
+		m_trace.Append(shard.m_trace, states);
 	else
-		m_stateContainer.insert(state);
+		DropTrace();
 
-	auto& timestamps = prevState.lock()->transitions[state];
+	auto shardStart = states[builder.GetStartState()];
+	if (m_builder.GetStartState() == StateGraph::NoState)
+		m_builder.SetStartState(shardStart);
+	else
+		AddTimestamp(addTransition(previousState, shardStart), firstTimestamp, firstTimestamp >= m_previousTimestamp ? firstTimestamp - m_previousTimestamp : 0);
 
-	if (timestamps.empty())
-		++state->indegree;
+	for (uint32_t state = 0; state < builder.GetStateCount(); ++state)
+	{
+		for (auto& [target, times] : builder.GetTransitions(state))
+		{
+			auto& mergedTimes = addTransition(states[state], states[target]);
+			MergeTimestamps(mergedTimes, times);
+			TrimTimestamps(mergedTimes);
+		}
+	}
 
-	timestamps.insert(timestamp);
+	previousState = states[shardLastState];
+	m_previousTimestamp = shard.m_previousTimestamp;
 
-	prevState = state;
+	if (m_retention.memoryBudget != 0)
+		EnforceMemoryBudget();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetFrameCount() const
+{
+	return m_frameCount;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetStateCount()
+{
+	if (m_isLearning)
+		return m_builder.GetStateCount();
+	return m_graph.GetStateCount();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+const typename BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::ValueRegistry& BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetRegistry() const
+{
+	return m_registry;
 }
 
-uint64_t FiniteStateMachine::GetStateCount()
+template<class StatePolicy, class DuplicatePolicy>
+const StateGraph& BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetGraph() const
 {
-	return m_stateContainer.size();
+	return m_graph;
 }
 
-uint64_t FiniteStateMachine::CombineSequences()
+template<class StatePolicy, class DuplicatePolicy>
+std::vector<uint32_t>::const_iterator BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::FindByIndex(const std::vector<uint32_t>& sortedByNumber, const uint64_t& stateIndex) const
 {
-	for (auto& currentState : m_stateContainer)
+	auto it = std::lower_bound(sortedByNumber.begin(), sortedByNumber.end(), stateIndex,
+		[this](uint32_t state, const uint64_t& index)
+		{
+			return m_graph.GetState(state).index < index;
+		}
+	);
+
+	if (it == sortedByNumber.end() || m_graph.GetState(*it).index != stateIndex)
+		return sortedByNumber.end();
+
+	return it;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::CombineSequences()
+{
+	DropTrace();
+	StateGraphBuilder builder(std::move(m_graph));
+	const auto startState = builder.GetStartState();
+
+	auto isSequenceState = [&builder, startState](uint32_t state)
+	{
+		return builder.GetState(state).indegree == 1
+			&& !builder.GetTransitions(state).empty()
+			&& state != startState;
+	};
+
+	for (uint32_t currentState = 0; currentState < builder.GetStateCount(); ++currentState)
 	{
-		if (currentState != m_startState
-			&& (currentState->transitions.empty()
-			|| currentState->indegree == 1))
+		if (currentState != startState
+			&& (builder.GetTransitions(currentState).empty()
+			|| builder.GetState(currentState).indegree == 1))
 			continue;
 
-		State::TransitionMap newTransitions;
+		StateGraphBuilder::TransitionMap newTransitions(builder.GetMemoryResource());
 
-		std::stack<State::TransitionMap*> transitionStack;
-		transitionStack.push(&currentState->transitions);
+		// The transitions of every sequence state, with the mean time of the steps from the current state into it
+		std::stack<std::pair<StateGraphBuilder::TransitionMap*, uint64_t>> transitionStack;
+		transitionStack.push({ &builder.GetTransitions(currentState), 0 });
 
 		while (!transitionStack.empty())
 		{
-			auto currentTransitions = transitionStack.top();
+			auto [currentTransitions, offset] = transitionStack.top();
 			transitionStack.pop();
 
 			for (auto& transition : *currentTransitions)
 			{
-				auto targetState = transition.first.lock();
-				if (targetState->indegree == 1
-					&& !targetState->transitions.empty()
-					&& targetState != m_startState)
+				auto targetState = transition.first;
+				if (isSequenceState(targetState))
 				{
-					transitionStack.push(&targetState->transitions);
+					transitionStack.push({ &builder.GetTransitions(targetState), offset + static_cast<uint64_t>(std::llround(transition.second.statistics.GetMean())) });
 					continue;
 				}
 
+				// The collapsed transition takes the time of the whole sequence
+				auto statistics = transition.second.statistics;
+				statistics.Shift(offset);
+
 				auto retPair =
 					newTransitions.insert(transition);
 
 				// Check if insertion took place
-				if (!retPair.second)
+				if (retPair.second)
+					(*retPair.first).second.statistics = std::move(statistics);
+				else
 				{
+					statistics.Merge((*retPair.first).second.statistics);
+
 					// If not, we need to reduce the reference count
 					// And check if stateIt is 1 now
-					if (--(*retPair.first).first.lock()->indegree == 1
-						&& !targetState->transitions.empty()
-						&& targetState != m_startState)
+					if (--builder.GetState(targetState).indegree == 1
+						&& !builder.GetTransitions(targetState).empty()
+						&& targetState != startState)
 					{
 						// If stateIt is, we add its transitions to the stack
-						transitionStack.push(&(*retPair.first).first.lock()->transitions);
+						transitionStack.push({ &builder.GetTransitions(targetState), static_cast<uint64_t>(std::llround(statistics.GetMean())) });
 						// And erase stateIt from the stack
 						newTransitions.erase(retPair.first);
 					}
 					else
 					{
 						// If stateIt is not, we need to insert the transition times
-						auto& timestamps = (*retPair.first).second;
-						timestamps.insert(
-							transition.second.begin(),
-							transition.second.end()
-						);
+						MergeTimestamps((*retPair.first).second.timestamps, transition.second.timestamps);
+						(*retPair.first).second.statistics = std::move(statistics);
 					}
 				}
 			}
 		}
 
-		currentState->transitions = newTransitions;
+		builder.GetTransitions(currentState) = std::move(newTransitions);
 	}
 
 	// Delete States with only one reference
-	return erase_if(m_stateContainer, [this](auto& state)
-		{
-			return state->indegree == 1 && !state->transitions.empty() && state != m_startState;
-		}
-	);
+	auto removed = builder.RemoveStates(isSequenceState);
+	m_graph = builder.Freeze();
+	SummarizeRun();
+
+	return removed;
 }
 
-#ifndef COMBINED_STATES
-void FiniteStateMachine::RemoveInputStates()
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::RemoveInputStates() requires (!StatePolicy::IsCombined)
 {
-	std::set<std::shared_ptr<State>, State> newStates;
-	auto currentState = m_startState;
-	uint64_t currentTime = 0;
-
-	auto newState = std::make_shared<State>( currentState->values, currentState->index, 0 );
-	newStates.insert(newState);
-	m_startState = newState;
+	auto currentState = m_graph.GetStartState();
+	if (currentState == StateGraph::NoState)
+		return;
 
-	// Go through all the times
-	while (!currentState->transitions.empty())
+	// The kept timestamps are only a part of the run
+	if (!IsKeepingAllTimestamps())
 	{
-		std::shared_ptr<State> nextState;
-
-		// Find the next transition
-		do {
-			const uint64_t* closestTime = nullptr;
-			for (auto& transition : currentState->transitions)
-			{
-				auto timeIt = std::find_if(
-					transition.second.begin(),
-					transition.second.end(),
-					[currentTime](const uint64_t& timestamp)
-					{
-						return currentTime < timestamp;
-					}
-				);
-
-				if (timeIt == transition.second.end())
-					continue;
+		RemoveInputStatesWithoutReplay();
+		return;
+	}
 
-				if (closestTime)
-					if (*timeIt > *closestTime)
-						continue;
+	StateTrace replayed;
+	auto& trace = GetTrace(replayed);
 
-				nextState = transition.first.lock();
-				closestTime = &*timeIt;
-			}
-			if (!nextState || !closestTime)
-				break;
+	StateGraphBuilder newStates;
 
-			currentTime = *closestTime;
-			currentState = nextState;
-		} while (currentState->values.front()->IsInput());
+	// The copy of every old state in the new states
+	std::vector<uint32_t> newIds(m_graph.GetStateCount(), StateGraph::NoState);
 
+	auto newState = newStates.AddState({ m_graph.GetState(currentState).valueId, m_graph.GetState(currentState).index, 0 });
+	newIds[currentState] = newState;
+	newStates.SetStartState(newState);
 
-		auto stateIt = newStates.find(currentState);
-		auto& stateValues = currentState->values;
+	// The outputs are connected with the time the run reached them
+	uint64_t currentTime = 0;
+	auto addStep = [&](uint32_t state, uint64_t timestamp)
+	{
+		auto& copiedState = newIds[state];
 
-		if (stateIt == newStates.end())
-		{
-			nextState = std::make_shared<State>( stateValues, currentState->index, 1 );
-			newStates.insert(nextState);
-		}
+		if (copiedState == StateGraph::NoState)
+			copiedState = newStates.AddState({ m_graph.GetState(state).valueId, m_graph.GetState(state).index, 1 });
 		else
 		{
-			nextState = *stateIt;
 			// Not always correct
-			++nextState->indegree;
+			++newStates.GetState(copiedState).indegree;
+		}
+
+		InsertTimestamp(newStates.GetTransitions(newState)[copiedState], timestamp, timestamp - currentTime);
+		newState = copiedState;
+		currentState = state;
+		currentTime = timestamp;
+	};
+
+	// The input state the run is in, after the last output
+	uint32_t inputState = StateGraph::NoState;
+	uint64_t inputTime = 0;
+
+	for (auto step = std::next(trace.begin()); step != trace.end(); ++step)
+	{
+		if (m_registry.IsInputState(m_graph.GetState(step->state).valueId))
+		{
+			inputState = step->state;
+			inputTime = step->timestamp;
+			continue;
 		}
 
-		newState->transitions[nextState].insert(currentTime);
-		newState = nextState;
+		addStep(step->state, step->timestamp);
+		inputState = StateGraph::NoState;
 	}
 
+	// The run ends in the last input state, or where no later transition is left
+	if (inputState != StateGraph::NoState)
+		addStep(inputState, inputTime);
+	else if (m_graph.GetOutdegree(currentState) != 0)
+		addStep(currentState, currentTime);
+
+	DropTrace();
+
 	// delete the old states
-	m_stateContainer.clear();
+	m_graph = newStates.Freeze();
+}
 
-	m_stateContainer = newStates;
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::RemoveInputStatesWithoutReplay() requires (!StatePolicy::IsCombined)
+{
+	StateGraphBuilder newStates;
+
+	// The copy of every old state in the new states
+	std::vector<uint32_t> newIds(m_graph.GetStateCount(), StateGraph::NoState);
+	auto copyState = [&](uint32_t state)
+	{
+		if (newIds[state] == StateGraph::NoState)
+			newIds[state] = newStates.AddState({ m_graph.GetState(state).valueId, m_graph.GetState(state).index, 0 });
+		return newIds[state];
+	};
+
+	auto isInput = [this](uint32_t state) { return m_registry.IsInputState(m_graph.GetState(state).valueId); };
+
+	auto startState = m_graph.GetStartState();
+	newStates.SetStartState(copyState(startState));
+
+	// The input states reached from the current source, marked with the source
+	std::vector<uint32_t> visitedFrom(m_graph.GetStateCount(), StateGraph::NoState);
+	std::stack<uint32_t> inputStates;
+
+	for (uint32_t source = 0; source < m_graph.GetStateCount(); ++source)
+	{
+		if (source != startState && isInput(source))
+			continue;
+
+		inputStates.push(source);
+		visitedFrom[source] = source;
+
+		while (!inputStates.empty())
+		{
+			auto state = inputStates.top();
+			inputStates.pop();
+
+			for (auto transition = m_graph.TransitionsBegin(state); transition != m_graph.TransitionsEnd(state); ++transition)
+			{
+				auto target = m_graph.GetTarget(transition);
+				if (isInput(target))
+				{
+					if (visitedFrom[target] != source)
+					{
+						visitedFrom[target] = source;
+						inputStates.push(target);
+					}
+					continue;
+				}
+
+				// Like the replay, the output transition takes the times of the transition into the output.
+				// If several outputs lead into the same input states, their transitions share these times.
+				auto newSource = copyState(source);
+				auto newTarget = copyState(target);
+				auto& times = newStates.GetTransitions(newSource)[newTarget];
+				if (times.statistics.GetCount() == 0)
+					++newStates.GetState(newTarget).indegree;
+
+				TransitionTimes outputTimes;
+				outputTimes.timestamps = m_graph.GetTimestamps(transition).Decode();
+				outputTimes.statistics = m_graph.GetStatistics(transition);
+				MergeTimestamps(times, outputTimes);
+			}
+		}
+	}
+
+	m_graph = newStates.Freeze();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+const StateTrace& BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetTrace(StateTrace& replayed) const
+{
+	if (m_isTraceRecorded)
+		return m_trace;
+
+	replayed = StateTrace::Replay(m_graph, m_graph.GetStartState());
+	return replayed;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::DropTrace()
+{
+	m_trace.Clear();
+	m_isTraceRecorded = false;
 }
-#endif
 
-uint64_t FiniteStateMachine::CombineSCC()
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::CombineSCC()
 {
-	std::stack<std::pair<std::weak_ptr<State>, State::TransitionMap::iterator>> openStates;
-	openStates.push({ m_startState, m_startState->transitions.begin() });
+	if (m_graph.GetStartState() == StateGraph::NoState)
+		return 0;
+
+	DropTrace();
+	StateGraphBuilder builder(std::move(m_graph));
+	auto index = [&builder](uint32_t state) { return builder.GetState(state).index; };
+
+	std::vector<uint32_t> lowlink(builder.GetStateCount(), StateGraph::NoState);
+
+	std::stack<std::pair<uint32_t, StateGraphBuilder::TransitionMap::iterator>> openStates;
+	openStates.push({ builder.GetStartState(), builder.GetTransitions(builder.GetStartState()).begin() });
 
 	while (!openStates.empty())
 	{
 		auto& currentElement = openStates.top();
-		auto currentState = currentElement.first.lock();
-		auto& currentTransitions = currentState->transitions;
+		auto currentState = currentElement.first;
+		auto& currentTransitions = builder.GetTransitions(currentState);
 
 		// Calculate the lowlink values
-		if (!currentState->lowlink.lock())
-			currentState->lowlink = currentState;
+		if (lowlink[currentState] == StateGraph::NoState)
+			lowlink[currentState] = currentState;
 		
 		while(currentElement.second != currentTransitions.end())
 		{
-			auto nextState = currentElement.second->first.lock();
+			auto nextState = currentElement.second->first;
 			
-			if (!nextState->lowlink.lock())
+			if (lowlink[nextState] == StateGraph::NoState)
 			{
-				if (nextState->index > currentState->index)
+				if (index(nextState) > index(currentState))
 				{
-					openStates.push({ nextState, nextState->transitions.begin() });
+					openStates.push({ nextState, builder.GetTransitions(nextState).begin() });
 					break;
 				}
 
-				if (nextState->index < currentState->lowlink.lock()->index)
-					currentState->lowlink = nextState;
+				if (index(nextState) < index(lowlink[currentState]))
+					lowlink[currentState] = nextState;
 			}
-			else if (nextState->lowlink.lock()->index < currentState->lowlink.lock()->index)
-				currentState->lowlink = nextState->lowlink;
+			else if (index(lowlink[nextState]) < index(lowlink[currentState]))
+				lowlink[currentState] = lowlink[nextState];
 
 			++currentElement.second;
 		}
@@ -273,27 +1125,25 @@ uint64_t FiniteStateMachine::CombineSCC()
 		openStates.pop();
 
 		// The lowlink value is calculated
-		if (currentState->lowlink.lock() != currentState)
+		if (lowlink[currentState] != currentState)
 		{
+			auto& lowlinkTransitions = builder.GetTransitions(lowlink[currentState]);
+
 			for (auto& transition : currentTransitions)
 			{
-				auto adjacentState = transition.first.lock();
+				auto adjacentState = transition.first;
 		
-				if (adjacentState->lowlink.lock() != adjacentState)
+				if (lowlink[adjacentState] != adjacentState)
 					continue;
 		
-				auto retPair = currentState->lowlink.lock()->transitions.insert(transition);
+				auto retPair = lowlinkTransitions.insert(transition);
 		
 				// Check if insertion took place
 				if (!retPair.second)
 				{
 					// If not, we need to insert the transition times
-					auto& timestamps = (*retPair.first).second;
-					timestamps.insert(
-						transition.second.begin(),
-						transition.second.end()
-					);
-					--adjacentState->indegree;
+					MergeTimestamps((*retPair.first).second, transition.second);
+					--builder.GetState(adjacentState).indegree;
 				}
 			}
 		
@@ -301,114 +1151,112 @@ uint64_t FiniteStateMachine::CombineSCC()
 		}
 		else
 		{
-			std::erase_if(currentTransitions, [](auto& transition)
+			std::erase_if(currentTransitions, [&lowlink](auto& transition)
 				{
-					auto adjacentState = transition.first.lock();
-					return adjacentState->lowlink.lock() != adjacentState;
+					return lowlink[transition.first] != transition.first;
 				}
 			);
 		}
 	}
  
-	return std::erase_if(m_stateContainer, [](const auto& state)
+	auto removed = builder.RemoveStates([&lowlink](uint32_t state)
 		{
-			return !state->lowlink.lock() || state->lowlink.lock() != state;
+			return lowlink[state] != state;
 		}
 	);
+	m_graph = builder.Freeze();
+	SummarizeRun();
+
+	return removed;
 }
 
-uint64_t FiniteStateMachine::MergeCircuits()
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::MergeCircuits()
 {
-	auto cmp = [](std::weak_ptr<State> a, std::weak_ptr<State> b)
-	{
-		return a.lock()->index < b.lock()->index;
-	};
-	std::vector<std::weak_ptr<State>> sortedByNumber;
-	std::copy(m_stateContainer.begin(), m_stateContainer.end(), back_inserter(sortedByNumber));
-	std::sort(sortedByNumber.begin(), sortedByNumber.end(), cmp);
+	auto sortedByNumber = m_graph.GetStatesByIndex();
 
-	auto end = sortedByNumber.end();
-	for (auto it = sortedByNumber.begin(); it != end; ++it)
-	{
-		auto currentState = (*it).lock();
+	DropTrace();
+	StateGraphBuilder builder(std::move(m_graph));
+	const auto startState = builder.GetStartState();
+	auto index = [&builder](uint32_t state) { return builder.GetState(state).index; };
+	auto indegree = [&builder](uint32_t state) -> uint64_t& { return builder.GetState(state).indegree; };
 
+	for (auto currentState : sortedByNumber)
+	{
 		// If the node is not reachable, stateIt can be ignored
-		if (currentState->indegree == 0 && currentState != m_startState)
+		if (indegree(currentState) == 0 && currentState != startState)
 			continue;
 
-		auto highestNumber = currentState->index;
+		auto highestNumber = index(currentState);
 
 		// Stack for states that need to be checked
-		std::stack<std::shared_ptr<State>> mergeStack;
-		std::shared_ptr<State> smallestState = nullptr;
+		std::stack<uint32_t> mergeStack;
+		uint32_t smallestState = StateGraph::NoState;
 
 		// Get all smaller states
-		for (auto& transition : currentState->transitions)
+		for (auto& transition : builder.GetTransitions(currentState))
 		{
-			auto adjacentState = transition.first.lock();
+			auto adjacentState = transition.first;
 
 			// We only merge with smaller numbers
-			if (adjacentState->index >= highestNumber)
+			if (index(adjacentState) >= highestNumber)
 				continue;
 
 			// We need to merge with the end of the chain
-			while (adjacentState->indegree == 0
-				&& adjacentState != m_startState)
+			while (indegree(adjacentState) == 0
+				&& adjacentState != startState
+				&& !builder.GetTransitions(adjacentState).empty())
 			{
-				//mergeStack.push(adjacentState);
-				adjacentState = adjacentState->transitions.begin()->first.lock();
+				adjacentState = builder.GetTransitions(adjacentState).begin()->first;
 			}
 
 			mergeStack.push(adjacentState);
 
-			if (!smallestState)
+			if (smallestState == StateGraph::NoState)
 				smallestState = adjacentState;
-			else if (smallestState->index > adjacentState->index)
+			else if (index(smallestState) > index(adjacentState))
 				smallestState = adjacentState;
 		}
 
-		if (mergeStack.empty() || !smallestState)
+		if (mergeStack.empty() || smallestState == StateGraph::NoState)
 			continue;
 		
-		const auto& smallestNumber = smallestState->index;
+		const auto smallestNumber = index(smallestState);
+		auto& smallestTransitions = builder.GetTransitions(smallestState);
 
 		// We go through the adjacent nodes of the smallest state
 		// To check if there are nodes between the smallest and highest state
 		// That we would need to add
-		for (auto& transition : smallestState->transitions)
+		for (auto& transition : smallestTransitions)
 		{
-			const auto& number = transition.first.lock()->index;
+			const auto number = index(transition.first);
 			if (number > smallestNumber
 				&& number < highestNumber)
-				mergeStack.push(transition.first.lock());
+				mergeStack.push(transition.first);
 		}
 
 		// We merge the highest and the smallest number
-		for (auto& transition : currentState->transitions)
+		for (auto& transition : builder.GetTransitions(currentState))
 		{
 			// If the transition ends in the lowest state
 			// We add the timestamps
-			if (transition.first.lock()->index == smallestNumber)
+			if (index(transition.first) == smallestNumber)
 			{
-				auto selfIt = smallestState->transitions.find(smallestState);
-				if (selfIt != smallestState->transitions.end())
-					--smallestState->indegree;
-				auto& timestampArray = smallestState->transitions[smallestState];
-				timestampArray.insert(
-					transition.second.begin(),
-					transition.second.end()
-				);
+				auto selfIt = smallestTransitions.find(smallestState);
+				if (selfIt != smallestTransitions.end())
+					--indegree(smallestState);
+				MergeTimestamps(smallestTransitions[smallestState], transition.second);
 			}
 			// If stateIt ends in a higher state,
 			// we add the whole transition
-			else if (transition.first.lock()->index > highestNumber)
-				smallestState->transitions.emplace(transition);
+			else if (index(transition.first) > highestNumber)
+				smallestTransitions.emplace(transition);
 		}
 
 		// We depreciate the highest state
-		currentState->indegree = 0;
-		currentState->transitions.clear();
-		currentState->transitions[smallestState] = {};
+		indegree(currentState) = 0;
+		builder.GetTransitions(currentState).clear();
+		builder.GetTransitions(currentState)[smallestState] = {};
 
 		// We merge with the smallest state
 		while (!mergeStack.empty())
@@ -417,27 +1265,30 @@ uint64_t FiniteStateMachine::MergeCircuits()
 			mergeStack.pop();
 
 			// We continue, if the state is the smallest state
-			if (currentState->index == smallestNumber)
+			if (index(currentState) == smallestNumber)
 				continue;
 
+			auto& currentTransitions = builder.GetTransitions(currentState);
+
 			// If the state was already merged, we need to update
 			// its merged node
-			if (currentState->indegree == 0
-				&& currentState->transitions.begin()->first.lock() != smallestState)
+			if (indegree(currentState) == 0
+				&& !currentTransitions.empty()
+				&& currentTransitions.begin()->first != smallestState)
 			{
-				currentState->transitions.clear();
-				currentState->transitions[smallestState] = {};
+				currentTransitions.clear();
+				currentTransitions[smallestState] = {};
 				continue;
 			}
 
 			// We go through the adjacent nodes
-			for (auto& transition : currentState->transitions)
+			for (auto& transition : currentTransitions)
 			{
-				auto adjacentState = transition.first.lock();
+				auto adjacentState = transition.first;
 				// If the adjacent State is greater than the highest number
 				// We add the whole transition to the smallest state
-				if (adjacentState->index > highestNumber)
-					smallestState->transitions.emplace(transition);
+				if (index(adjacentState) > highestNumber)
+					smallestTransitions.emplace(transition);
 
 				// Or push the state
 				else
@@ -445,202 +1296,264 @@ uint64_t FiniteStateMachine::MergeCircuits()
 			}
 			
 			// We then depreciate the state
-			currentState->indegree = 0;
-			currentState->transitions.clear();
-			currentState->transitions[smallestState] = {};
+			indegree(currentState) = 0;
+			currentTransitions.clear();
+			currentTransitions[smallestState] = {};
 		}
 
 		// Remove depreciated transitions from smallest state
-		std::erase_if(smallestState->transitions, [](auto& transition)
+		std::erase_if(smallestTransitions, [&indegree](auto& transition)
 			{
-				return transition.first.lock()->indegree == 0;
+				return indegree(transition.first) == 0;
 			}
 		);
 	}
 
 	// Delete depreciated states
-	return std::erase_if(m_stateContainer, [this](auto& state)
+	auto removed = builder.RemoveStates([&indegree, startState](uint32_t state)
 		{
-			return state->indegree == 0 && state != m_startState;
+			return indegree(state) == 0 && state != startState;
 		}
 	);
+	m_graph = builder.Freeze();
+	SummarizeRun();
+
+	return removed;
 }
 
-void FiniteStateMachine::RenumberStates()
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::RenumberStates()
 {
-	auto cmp = [](std::shared_ptr<State> a, std::shared_ptr<State> b)
+	m_graph.RenumberStates();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetRunSteps(std::vector<RunStep>& steps, std::vector<std::size_t>& offsets) const
+{
+	StateTrace replayed;
+	auto& trace = GetTrace(replayed);
+
+	std::vector<RunStep> ordered;
+	ordered.reserve(trace.size());
+
+	// Like the replay, the first time is taken from 0
+	StateTrace::Step previous;
+	for (auto& step : trace)
 	{
-		return a->index < b->index;
-	};
-	std::vector<std::shared_ptr<State>> sortedByNumber;
-	std::copy(m_stateContainer.begin(), m_stateContainer.end(), back_inserter(sortedByNumber));
-	std::sort(sortedByNumber.begin(), sortedByNumber.end(), cmp);
+		if (previous.state != StateGraph::NoState)
+		{
+			auto transition = m_graph.FindTransition(previous.state, step.state);
+			if (transition != StateGraph::NoTransition)
+				ordered.push_back({ transition, step.timestamp, step.timestamp - previous.timestamp });
+		}
+		previous = { step.state, previous.state != StateGraph::NoState ? step.timestamp : 0 };
+	}
+
+	// Grouped by their transition with a counting sort
+	offsets.assign(m_graph.GetTransitionCount() + 1, 0);
+	for (auto& step : ordered)
+		++offsets[step.transition + 1];
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
 
-	auto count = 0;
-	for (auto& state : sortedByNumber)
-		state->index = count++;
+	steps.resize(ordered.size());
+	auto next = offsets;
+	for (auto& step : ordered)
+		steps[next[step.transition]++] = step;
 }
 
-void FiniteStateMachine::RelativeTimes()
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::SummarizeRun()
 {
-	auto currentState = m_startState;
-	uint64_t lastTimestamp = 0;
+	if (!IsKeepingAllTimestamps() || m_graph.GetStartState() == StateGraph::NoState)
+		return;
+
+	std::vector<RunStep> steps;
+	std::vector<std::size_t> offsets;
+	GetRunSteps(steps, offsets);
+
+	StateGraphBuilder builder(std::move(m_graph));
 
-	while (currentState)
+	// The transitions of the builder are in the order of the frozen graph
+	uint32_t transition = 0;
+	for (uint32_t state = 0; state < builder.GetStateCount(); ++state)
 	{
-		std::shared_ptr<State> nextState;
-		const uint64_t* nextTimestamp = nullptr;
-		for (auto& [adjacent, timestamps] : currentState->transitions)
+		for (auto& [target, times] : builder.GetTransitions(state))
 		{
-			auto lowIt = std::find_if(timestamps.begin(), timestamps.end(),
-				[&lastTimestamp](auto& timestamp)
-				{
-					return timestamp >= lastTimestamp;
-				}
-			);
+			auto first = steps.begin() + offsets[transition];
+			auto last = steps.begin() + offsets[++transition];
 
-			if (lowIt == timestamps.end())
+			// A transition the run does not take keeps the statistics the pass merged
+			if (first == last)
 				continue;
 
-			if (!nextTimestamp || *lowIt < *nextTimestamp)
-			{
-				nextState = adjacent.lock();
-				nextTimestamp = &(*lowIt);
-			}
+			times.statistics.Clear();
+			for (auto step = first; step != last; ++step)
+				times.statistics.Add(step->duration);
 		}
+	}
+
+	m_graph = builder.Freeze();
+}
 
-		if (!nextTimestamp)
-			return;
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::RelativeTimes()
+{
+	// Only the statistics are left, they hold the durations since the frames were added
+	if (m_timestampLimit == 0)
+		return;
 
-		auto relTime = *nextTimestamp - lastTimestamp;
-		lastTimestamp = *nextTimestamp;
+	// Every step of the run replaces its timestamp by the time since the previous step
+	std::vector<RunStep> relativeTimes;
+	std::vector<std::size_t> offsets;
+	GetRunSteps(relativeTimes, offsets);
 
-		currentState->transitions[nextState].erase(*nextTimestamp);
-		currentState->transitions[nextState].insert(relTime);
-		currentState = nextState;
+	DropTrace();
+
+	StateGraphBuilder builder(std::move(m_graph));
+
+	// The transitions of the builder are in the order of the frozen graph
+	uint32_t transition = 0;
+	std::vector<uint64_t> replaced;
+	std::vector<uint64_t> durations;
+	for (uint32_t state = 0; state < builder.GetStateCount(); ++state)
+	{
+		for (auto& [target, times] : builder.GetTransitions(state))
+		{
+			auto first = relativeTimes.begin() + offsets[transition];
+			auto last = relativeTimes.begin() + offsets[++transition];
+
+			if (first != last)
+			{
+				replaced.clear();
+				durations.clear();
+				for (auto relativeTime = first; relativeTime != last; ++relativeTime)
+				{
+					replaced.push_back(relativeTime->timestamp);
+					durations.push_back(relativeTime->duration);
+				}
+
+				std::sort(replaced.begin(), replaced.end());
+				std::sort(durations.begin(), durations.end());
+				durations.erase(std::unique(durations.begin(), durations.end()), durations.end());
+
+				TimestampVector kept(times.timestamps.get_allocator());
+				std::set_difference(times.timestamps.begin(), times.timestamps.end(), replaced.begin(), replaced.end(), std::back_inserter(kept));
+				times.timestamps.clear();
+				std::set_union(kept.begin(), kept.end(), durations.begin(), durations.end(), std::back_inserter(times.timestamps));
+			}
+		}
 	}
+
+	m_graph = builder.Freeze();
 }
 
-void FiniteStateMachine::CutToPart(const uint64_t& startIndex, const uint64_t& endIndex, bool ignoreBackEdges /*= false*/, uint64_t* tabooState /*= nullptr*/)
+template<class StatePolicy, class DuplicatePolicy>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::CutToPart(const uint64_t& startIndex, const uint64_t& endIndex, bool ignoreBackEdges /*= false*/, uint64_t* tabooState /*= nullptr*/)
 {
-	auto findIt = std::find_if(m_stateContainer.begin(), m_stateContainer.end(),
-		[startIndex](std::shared_ptr<State> state)
-		{
-			return state->index == startIndex;
-		}
-	);
+	auto newStart = m_graph.FindState(startIndex);
 
-	if (findIt == m_stateContainer.end())
+	if (newStart == StateGraph::NoState)
 		return;
 
-	m_startState = *findIt;
+	auto backState = m_graph.FindState(endIndex);
 
-	std::set<std::shared_ptr<State>, State> newContainer;
+	DropTrace();
+	StateGraphBuilder builder(std::move(m_graph));
+	builder.SetStartState(newStart);
+	auto index = [&builder](uint32_t state) { return builder.GetState(state).index; };
 
-	std::stack<std::shared_ptr<State>> stack;
-	stack.push(m_startState);
+	std::vector<bool> isInPart(builder.GetStateCount(), false);
+
+	std::stack<uint32_t> stack;
+	stack.push(newStart);
 
 	while (!stack.empty())
 	{
 		auto currentState = stack.top();
 		stack.pop();
-		newContainer.insert(currentState);
+		isInPart[currentState] = true;
+
+		auto& transitions = builder.GetTransitions(currentState);
 
 		if (ignoreBackEdges)
-			std::erase_if(currentState->transitions,
-				[startIndex](const auto& transition)
+			std::erase_if(transitions,
+				[&index, startIndex](const auto& transition)
 				{
-					return transition.first.lock()->index == startIndex;
+					return index(transition.first) == startIndex;
 				}
 			);
 
 		if (tabooState)
-			std::erase_if(currentState->transitions,
-				[tabooState](const auto& transition)
+			std::erase_if(transitions,
+				[&index, tabooState](const auto& transition)
 				{
-					return transition.first.lock()->index == *tabooState;
+					return index(transition.first) == *tabooState;
 				}
 			);
 
-		for (const auto& [adjacent, timestamps] : currentState->transitions)
-			if (currentState->index != endIndex && newContainer.find(adjacent.lock()) == newContainer.end())
-				stack.push(adjacent.lock());
+		for (const auto& [adjacent, times] : transitions)
+			if (index(currentState) != endIndex && !isInPart[adjacent])
+				stack.push(adjacent);
 	}
 
-	auto backIt = std::find_if(newContainer.begin(), newContainer.end(),
-		[endIndex](std::shared_ptr<State> state)
-		{
-			return state->index == endIndex;
-		}
-	);
-
-	if (backIt == newContainer.end())
-		return;
-
-	std::erase_if((*backIt)->transitions, [&newContainer](auto& transition)
-		{
-			return newContainer.find(transition.first.lock()) == newContainer.end();
-		}
-	);
+	if (backState != StateGraph::NoState && isInPart[backState])
+	{
+		std::erase_if(builder.GetTransitions(backState), [&isInPart](auto& transition)
+			{
+				return !isInPart[transition.first];
+			}
+		);
 
-	m_stateContainer.clear();
+		builder.RemoveStates([&isInPart](uint32_t state)
+			{
+				return !isInPart[state];
+			}
+		);
+	}
 
-	m_stateContainer = newContainer;
+	m_graph = builder.Freeze();
 }
 
-std::string FiniteStateMachine::GetStateValues(const uint64_t& stateNumber) const
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetStateValues(const uint64_t& stateNumber) const
 {
-	auto findIt = std::find_if(m_stateContainer.begin(), m_stateContainer.end(),
-		[stateNumber](std::shared_ptr<State> state)
-		{
-			return state->index == stateNumber;
-		}
-	);
+	auto state = m_graph.FindState(stateNumber);
 
-	if (findIt == m_stateContainer.end())
+	if (state == StateGraph::NoState)
 		return "";
 
-	auto currentState = *findIt;
+	auto& currentState = m_graph.GetState(state);
 
-	std::string outString = "State " + std::to_string(currentState->index);
+	std::string outString = "State " + std::to_string(currentState.index);
 
-	outString +=
-#ifndef COMBINED_STATES
-		" (" + std::string(currentState->values.front()->IsInput() ? "Input" : "Output") + ")"
-#endif
-		":\n{";
+	if constexpr (!StatePolicy::IsCombined)
+		outString += " (" + std::string(m_registry.IsInputState(currentState.valueId) ? "Input" : "Output") + ")";
+	outString += ":\n{";
 
-	for(auto& value : currentState->values)
-		outString += "\n\t" + value->Print();
+	outString += m_registry.PrintStateValues(currentState.valueId);
 
 	outString += "\n}\n";
 
-	outString += "Input Transitions:\t" + std::to_string(currentState->indegree) + "\n";
-	outString += "Output Transitions:\t" + std::to_string(currentState->transitions.size());
+	outString += "Input Transitions:\t" + std::to_string(currentState.indegree) + "\n";
+	outString += "Output Transitions:\t" + std::to_string(m_graph.GetOutdegree(state));
 
 	return outString;
 }
 
-std::string FiniteStateMachine::GetTransitionTimes(const uint64_t& stateIndex) const
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetTransitionTimes(const uint64_t& stateIndex) const
 {
-	auto findIt = std::find_if(m_stateContainer.begin(), m_stateContainer.end(),
-		[stateIndex](std::shared_ptr<State> state)
-		{
-			return state->index == stateIndex;
-		}
-	);
+	auto state = m_graph.FindState(stateIndex);
 
-	if (findIt == m_stateContainer.end())
+	if (state == StateGraph::NoState)
 		return "";
 
-	auto currentState = *findIt;
-
-	std::string outString = "State " + std::to_string(currentState->index) + "{";
+	std::string outString = "State " + std::to_string(m_graph.GetState(state).index) + "{";
 
-	for (auto& transition : currentState->transitions)
+	for (auto transition = m_graph.TransitionsBegin(state); transition != m_graph.TransitionsEnd(state); ++transition)
 	{
-		outString += "\n\t" + std::to_string(transition.first.lock()->index) + ":\t{ ";
-		for (auto& time : transition.second)
+		outString += "\n\t" + std::to_string(m_graph.GetState(m_graph.GetTarget(transition)).index) + ":\t{ ";
+		for (auto& time : m_graph.GetTimestamps(transition))
 			outString += std::to_string((float)time * 1e-6) + "s ";
 		outString += "}";
 	}
@@ -649,81 +1562,108 @@ std::string FiniteStateMachine::GetTransitionTimes(const uint64_t& stateIndex) c
 	return outString;
 }
 
-std::string FiniteStateMachine::PrintTimes() const
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::GetTransitionStatistics(const uint64_t& stateIndex) const
+{
+	auto state = m_graph.FindState(stateIndex);
+
+	if (state == StateGraph::NoState)
+		return "";
+
+	auto seconds = [](double time) { return std::to_string(time * 1e-6) + "s"; };
+
+	std::string outString = "State " + std::to_string(m_graph.GetState(state).index) + "{";
+
+	for (auto transition = m_graph.TransitionsBegin(state); transition != m_graph.TransitionsEnd(state); ++transition)
+	{
+		auto& statistics = m_graph.GetStatistics(transition);
+		outString += "\n\t" + std::to_string(m_graph.GetState(m_graph.GetTarget(transition)).index) + ":\t{ "
+			+ "count " + std::to_string(statistics.GetCount())
+			+ ", min " + seconds(static_cast<double>(statistics.GetMin()))
+			+ ", mean " + seconds(statistics.GetMean())
+			+ ", deviation " + seconds(statistics.GetStandardDeviation())
+			+ ", P50 " + seconds(statistics.GetQuantile(0.5))
+			+ ", P95 " + seconds(statistics.GetQuantile(0.95))
+			+ ", P99 " + seconds(statistics.GetQuantile(0.99))
+			+ ", max " + seconds(static_cast<double>(statistics.GetMax())) + " }";
+	}
+	outString += "\n}";
+
+	return outString;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::PrintTimes() const
 {
-	if (!m_startState)
+	auto currentState = m_graph.GetStartState();
+
+	if (currentState == StateGraph::NoState)
 		return "No States exist!";
-	if (m_startState->transitions.empty())
+	if (m_graph.GetOutdegree(currentState) == 0)
 		return "No Circuits exist!";
 
-	auto currentState = m_startState;
 	std::string outString = "";
 
 	uint64_t lastTimestamp = 0;
 
-	while (currentState)
+	// The walk follows the first transition, so it ends at the first state it reaches again
+	std::vector<bool> isVisited(m_graph.GetStateCount(), false);
+
+	while (currentState != StateGraph::NoState && !isVisited[currentState])
 	{
-		outString += "State " + std::to_string(currentState->index);
+		isVisited[currentState] = true;
 
-		outString +=
-#ifndef COMBINED_STATES
-			" (" + std::string(currentState->values.front()->IsInput() ? "Input" : "Output") + ")"
-#endif
-			":\n{";
+		auto& state = m_graph.GetState(currentState);
+		outString += "State " + std::to_string(state.index);
 
-		for (auto& value : currentState->values)
-			outString += "\n\t" + value->Print();
+		if constexpr (!StatePolicy::IsCombined)
+			outString += " (" + std::string(m_registry.IsInputState(state.valueId) ? "Input" : "Output") + ")";
+		outString += ":\n{";
+
+		outString += m_registry.PrintStateValues(state.valueId);
 
 		outString += "\n}\n";
 
 		float absTime = lastTimestamp * 1e-6f;
 		outString += "Absolute Start Time: " + std::to_string(absTime) + "s\n";
 
-		if (currentState->transitions.empty())
+		if (m_graph.GetOutdegree(currentState) == 0)
 			return outString;
 
-		for (auto& transition : currentState->transitions)
+		auto selfTransition = m_graph.FindTransition(currentState, currentState);
+		if (selfTransition != StateGraph::NoTransition && !m_graph.GetTimestamps(selfTransition).empty())
 		{
-			if (transition.first.lock() != currentState)
-				continue;
+			auto timestamps = m_graph.GetTimestamps(selfTransition);
 
 			outString += "Cycle Times: ( ";
 
-			auto end = std::prev(transition.second.end());
+			auto remaining = timestamps.size();
 
-			for (auto it = transition.second.begin(); it != end; ++it)
+			for (auto currentTime : timestamps)
 			{
-				auto currentTime = *it;
 				float time = (currentTime - lastTimestamp) * 1e-6f;
-				outString += std::to_string(time) + "s, ";
+				outString += std::to_string(time) + (--remaining != 0 ? "s, " : "s )\n");
 				lastTimestamp = currentTime;
 			}
-			
-			auto currentTime = *transition.second.rbegin();
-			float time = (currentTime - lastTimestamp) * 1e-6f;
-			outString += std::to_string(time) + "s )\n";
-			lastTimestamp = currentTime;
-
-			break;
 		}
 
-		std::shared_ptr<State> nextState;
+		uint32_t nextState = StateGraph::NoState;
 
-		for (auto& transition : currentState->transitions)
+		for (auto transition = m_graph.TransitionsBegin(currentState); transition != m_graph.TransitionsEnd(currentState); ++transition)
 		{
-			if (transition.first.lock() == currentState)
+			if (m_graph.GetTarget(transition) == currentState || m_graph.GetTimestamps(transition).empty())
 				continue;
 
-			nextState = transition.first.lock();
+			nextState = m_graph.GetTarget(transition);
 
-			auto currentTime = *transition.second.begin();
+			auto currentTime = m_graph.GetTimestamps(transition).front();
 			float time = (currentTime - lastTimestamp) * 1e-6f;
 			outString += "Transition to next: " + std::to_string(time) + "s\n";
 			lastTimestamp = currentTime;
 
 			break;
 		}
-		if (nextState == nullptr)
+		if (nextState == StateGraph::NoState)
 			return outString;
 
 		outString += "\n\n";
@@ -734,19 +1674,14 @@ std::string FiniteStateMachine::PrintTimes() const
 	return outString;
 }
 
-std::string FiniteStateMachine::PrintTimeAutomata(
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::PrintTimeAutomata(
 	const uint64_t& startState /*= 0*/,
 	const uint64_t& finalState /*= 0*/,
 	const std::string& statePrefix /*= "s"*/,
 	unsigned short precision /*= 3*/) const
 {
-	auto cmp = [](std::shared_ptr<State> a, std::shared_ptr<State> b)
-	{
-		return a->index < b->index;
-	};
-	std::vector<std::shared_ptr<State>> sortedByNumber;
-	std::copy(m_stateContainer.begin(), m_stateContainer.end(), back_inserter(sortedByNumber));
-	std::sort(sortedByNumber.begin(), sortedByNumber.end(), cmp);
+	auto& sortedByNumber = m_graph.GetStatesByIndex();
 
 	bool printAll = startState >= finalState;
 
@@ -762,33 +1697,24 @@ std::string FiniteStateMachine::PrintTimeAutomata(
 
 	uint64_t startTime = 0;
 	
-	auto currentState = m_startState;
+	auto currentState = m_graph.GetStartState();
 
 	if (!printAll)
 	{
-		auto findIt = std::find_if(
-			sortedByNumber.begin(),
-			sortedByNumber.end(),
-			[startState](std::shared_ptr<State> state)
-			{
-				return startState == state->index;
-			}
-		);
+		currentState = m_graph.FindState(startState);
 
-		if (findIt == sortedByNumber.end())
+		if (currentState == StateGraph::NoState)
 			return "";
 
-		currentState = *findIt;
-
-		for (auto& state : sortedByNumber)
+		for (auto state : sortedByNumber)
 		{
-			if (state->index >= startState)
+			if (m_graph.GetState(state).index >= startState)
 				break;
 			
-			auto it = state->transitions.find(currentState);
-			if (state->transitions.end() != it)
+			auto transition = m_graph.FindTransition(state, currentState);
+			if (transition != StateGraph::NoTransition)
 			{
-				uint64_t latestTime = *(*it).second.rbegin();
+				uint64_t latestTime = m_graph.GetTimestamps(transition).back();
 				if (latestTime > startTime)
 					startTime = latestTime;
 			}
@@ -796,62 +1722,49 @@ std::string FiniteStateMachine::PrintTimeAutomata(
 		}
 	}
 
-	while (printAll
-		? !currentState->transitions.empty()
-		: currentState->index != finalState && !currentState->transitions.empty())
-	{
-		std::string stateName = statePrefix + std::to_string(currentState->index);
-		
-		stateStringVector.insert(stateName);
-
-		std::shared_ptr<State> nextState;
-		const uint64_t* closestTime = nullptr;
+	// The whole run is the trace, a part of it is replayed from its start
+	StateTrace replayed;
+	auto& trace = printAll ? GetTrace(replayed) : (replayed = StateTrace::Replay(m_graph, currentState, startTime));
+	if (trace.empty())
+		return "";
 
-		for (auto& transition : currentState->transitions)
-		{
-			auto timeIt = std::find_if(
-				transition.second.begin(),
-				transition.second.end(),
-				[startTime](const uint64_t& timestamp)
-				{
-					return startTime < timestamp;
-				}
-			);
+	// Like the replay, the times of the whole run start at 0
+	currentState = trace.begin()->state;
 
-			if (timeIt == transition.second.end())
-				continue;
+	for (auto step = std::next(trace.begin()); step != trace.end(); ++step)
+	{
+		if (!printAll && m_graph.GetState(currentState).index == finalState)
+			break;
 
-			if (closestTime)
-				if (*timeIt > *closestTime)
-					continue;
-			
-			nextState = transition.first.lock();
-			closestTime = &*timeIt;
-		}
+		std::string stateName = statePrefix + std::to_string(m_graph.GetState(currentState).index);
 
-		if (!nextState)
-			break;
+		stateStringVector.insert(stateName);
 
-		std::stringstream transStr;
+		// Formatted like a fixed stream, without a stream per step
+		float timeDiff = (step->timestamp - startTime) * 1e-6f;
+		char digits[64];
+		auto end = std::to_chars(digits, digits + sizeof(digits) - 1, timeDiff, std::chars_format::fixed, precision).ptr;
+		*end++ = 's';
+		std::string_view timeString(digits, end - digits);
 
-		float timeDiff = (*closestTime - startTime) * 1e-6f;
-		transStr.precision(precision);
-		transStr << std::fixed << timeDiff << 's';
+		alphabetStringVector.emplace(timeString);
 
-		alphabetStringVector.insert(transStr.str());
+		transitionString += stateName;
+		transitionString += ':';
+		transitionString += timeString;
+		transitionString += '>';
+		transitionString += statePrefix + std::to_string(m_graph.GetState(step->state).index) + '\n';
 
-		transitionString += stateName + ":" + transStr.str() + ">" + statePrefix + std::to_string(nextState->index) + '\n';
-	
-		currentState = nextState;
-		startTime = *closestTime;
+		currentState = step->state;
+		startTime = step->timestamp;
 	}
 
 	if (printAll
 		? currentState == sortedByNumber.back()
-		: currentState->index == finalState)
-		acceptingString += statePrefix + std::to_string(currentState->index) + '\n';
+		: m_graph.GetState(currentState).index == finalState)
+		acceptingString += statePrefix + std::to_string(m_graph.GetState(currentState).index) + '\n';
 
-	stateStringVector.insert(statePrefix + std::to_string(currentState->index));
+	stateStringVector.insert(statePrefix + std::to_string(m_graph.GetState(currentState).index));
 
 	for (auto& state : stateStringVector)
 		stateString += state + '\n';
@@ -862,59 +1775,51 @@ std::string FiniteStateMachine::PrintTimeAutomata(
 
 }
 
-std::string FiniteStateMachine::PrintRightLinearGrammar(
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::PrintRightLinearGrammar(
 	const uint64_t& startState /*= 0*/,
 	const uint64_t& finalState /*= 0*/,
 	const std::string& statePrefix /*= "s"*/,
 	const std::string& transitionPrefix /*= ""*/,
 	bool printProcentualDiff /*= false*/) const
 {
-	auto cmp = [](std::shared_ptr<State> a, std::shared_ptr<State> b)
-	{
-		return a->index < b->index;
-	};
-	std::set<std::shared_ptr<State>, decltype(cmp)> sortedByNumber;
-	sortedByNumber.insert(m_stateContainer.begin(), m_stateContainer.end());
+	auto& sortedByNumber = m_graph.GetStatesByIndex();
 	
 	bool printAll = startState >= finalState;
 	uint64_t transitionCount = 0;
 
-	auto startIt = printAll
-		? sortedByNumber.begin()
-		: std::find_if(sortedByNumber.begin(), sortedByNumber.end(),
-			[startState](std::shared_ptr<State> state)
-			{
-				return state->index == startState;
-			});
+	auto startIt = sortedByNumber.begin();
+
+	if (!printAll)
+	{
+		startIt = FindByIndex(sortedByNumber, startState);
+		if (startIt == sortedByNumber.end())
+			return "";
+	}
 
 	std::string retString = "";
 
 	for (; startIt != sortedByNumber.end(); ++startIt)
 	{
 		auto currentState = *startIt;
+		auto currentIndex = m_graph.GetState(currentState).index;
 
-		if (!printAll && currentState->index >= finalState)
+		if (!printAll && currentIndex >= finalState)
 			break;
 
-		retString += statePrefix + std::to_string(currentState->index) + " ->";
+		retString += statePrefix + std::to_string(currentIndex) + " ->";
 
-		for (const auto& transition : currentState->transitions)
+		for (auto transition = m_graph.TransitionsBegin(currentState); transition != m_graph.TransitionsEnd(currentState); ++transition)
 		{
-			auto adjacentState = transition.first.lock();
+			auto adjacentState = m_graph.GetTarget(transition);
+			auto& statistics = m_graph.GetStatistics(transition);
 
 			if (printProcentualDiff)
 			{
-				auto size = transition.second.size();
-				if (size > 1)
+				if (statistics.GetCount() > 1)
 				{
-					auto maxValue = *transition.second.rbegin();
-					auto minValue = *transition.second.begin();
-					auto sum = std::accumulate<std::set<uint64_t>::iterator, uint64_t>(transition.second.begin(), transition.second.end(), 0);
-					double median = (double)sum / (double)size;
-					double minFraction = median / minValue - 1.0f;
-					double maxFraction = maxValue / median - 1.0f;
 					std::stringstream fractionStr;
-					fractionStr << std::fixed << std::setprecision(2) << std::max(minFraction, maxFraction) * 100.0f;
+					fractionStr << std::fixed << std::setprecision(2) << statistics.GetSpread() * 100.0f;
 					retString += " " + fractionStr.str() + '%';
 				}
 				else
@@ -922,14 +1827,14 @@ std::string FiniteStateMachine::PrintRightLinearGrammar(
 			}
 			else
 				retString += " " + transitionPrefix == ""
-					? std::to_string(transition.second.size())
+					? std::to_string(statistics.GetCount())
 					: transitionPrefix + std::to_string(transitionCount++);
 
 			if (printAll
-				? !adjacentState->transitions.empty()
-				: !adjacentState->transitions.empty()
-				&& adjacentState->index != finalState)
-				retString += " " + statePrefix + std::to_string(adjacentState->index);
+				? m_graph.GetOutdegree(adjacentState) != 0
+				: m_graph.GetOutdegree(adjacentState) != 0
+				&& m_graph.GetState(adjacentState).index != finalState)
+				retString += " " + statePrefix + std::to_string(m_graph.GetState(adjacentState).index);
 
 			retString += " |";
 		}
@@ -942,16 +1847,11 @@ std::string FiniteStateMachine::PrintRightLinearGrammar(
 	return retString;
 }
 
-std::string FiniteStateMachine::PrintRegularAutomota(const uint64_t& startState /*= 0*/, const uint64_t& finalState /*= 0*/, const std::string& statePrefix /*= "s"*/, const std::string& transitionPrefix /*= "t" */,
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::PrintRegularAutomota(const uint64_t& startState /*= 0*/, const uint64_t& finalState /*= 0*/, const std::string& statePrefix /*= "s"*/, const std::string& transitionPrefix /*= "t" */,
 	bool printProcentualDiff /*= false*/)
 {
-	auto cmp = [](std::shared_ptr<State> a, std::shared_ptr<State> b)
-	{
-		return a->index < b->index;
-	};
-	std::vector<std::shared_ptr<State>> sortedByNumber;
-	std::copy(m_stateContainer.begin(), m_stateContainer.end(), back_inserter(sortedByNumber));
-	std::sort(sortedByNumber.begin(), sortedByNumber.end(), cmp);
+	auto& sortedByNumber = m_graph.GetStatesByIndex();
 	auto end = sortedByNumber.end();
 
 	bool printAll = startState >= finalState;
@@ -965,21 +1865,14 @@ std::string FiniteStateMachine::PrintRegularAutomota(const uint64_t& startState
 	std::string transitionString = "#transitions\n";
 
 	initialString += statePrefix
-		+ (printAll ? std::to_string(m_startState->index) : std::to_string(startState))
+		+ (printAll ? std::to_string(m_graph.GetState(m_graph.GetStartState()).index) : std::to_string(startState))
 		+ '\n';
 
 	auto currentStateIt = sortedByNumber.begin();
 
 	if (!printAll)
 	{
-		auto findIt = std::find_if(
-			currentStateIt,
-			end,
-			[startState](std::shared_ptr<State> state)
-			{
-				return startState == state->index;
-			}
-		);
+		auto findIt = FindByIndex(sortedByNumber, startState);
 
 		if (findIt == end)
 			return "";
@@ -989,20 +1882,21 @@ std::string FiniteStateMachine::PrintRegularAutomota(const uint64_t& startState
 
 	std::size_t transitionCount = 0;
 
-	for(; currentStateIt != end && (printAll || (*currentStateIt)->index <= finalState); ++currentStateIt)
+	for(; currentStateIt != end && (printAll || m_graph.GetState(*currentStateIt).index <= finalState); ++currentStateIt)
 	{
-		auto& currentState = *currentStateIt;
-		std::string stateName = statePrefix + std::to_string(currentState->index);
+		auto currentState = *currentStateIt;
+		auto currentIndex = m_graph.GetState(currentState).index;
+		std::string stateName = statePrefix + std::to_string(currentIndex);
 
 		stateStringVector.insert(stateName);
 
-		if (currentState->transitions.empty()
-			|| !printAll && currentState->index == finalState)
+		if (m_graph.GetOutdegree(currentState) == 0
+			|| !printAll && currentIndex == finalState)
 			acceptingString += stateName + '\n';
 
-		for (const auto& transition : currentState->transitions)
+		for (auto transition = m_graph.TransitionsBegin(currentState); transition != m_graph.TransitionsEnd(currentState); ++transition)
 		{
-			auto nextNumber = transition.first.lock()->index;
+			auto nextNumber = m_graph.GetState(m_graph.GetTarget(transition)).index;
 			if (!printAll && (nextNumber < startState || nextNumber > finalState))
 				continue;
 
@@ -1010,17 +1904,11 @@ std::string FiniteStateMachine::PrintRegularAutomota(const uint64_t& startState
 			
 			if (printProcentualDiff)
 			{
-				auto size = transition.second.size();
-				if (size > 1)
+				auto& statistics = m_graph.GetStatistics(transition);
+				if (statistics.GetCount() > 1)
 				{
-					auto maxValue = *transition.second.rbegin();
-					auto minValue = *transition.second.begin();
-					auto sum = std::accumulate<std::set<uint64_t>::iterator, uint64_t>(transition.second.begin(), transition.second.end(), 0);
-					double median = (double)sum / (double)size;
-					double minFraction = median / minValue - 1.0f;
-					double maxFraction = maxValue / median - 1.0f;
 					std::stringstream fractionStr;
-					fractionStr << std::fixed << std::setprecision(2) << std::max(minFraction, maxFraction) * 100.0f;
+					fractionStr << std::fixed << std::setprecision(2) << statistics.GetSpread() * 100.0f;
 					transStr = fractionStr.str() + '%';
 				}
 				else
@@ -1042,3 +1930,42 @@ std::string FiniteStateMachine::PrintRegularAutomota(const uint64_t& startState
 
 	return stateString + initialString + acceptingString + alphabetString + transitionString;
 }
+
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::PrintDuplicates(std::size_t topCount) const requires DuplicatePolicy::IsCounted
+{
+	auto& stateHits = m_registry.GetStateHits();
+
+	uint64_t hitCount = 0;
+	uint64_t reachedCount = 0;
+	for (auto& hits : stateHits)
+	{
+		hitCount += hits.count;
+		reachedCount += hits.count != 0;
+	}
+
+	std::string outString = "Duplicates: " + std::to_string(m_registry.GetNumberOfDuplicates()) + "\n";
+	outString += "Hits: " + std::to_string(hitCount) + " on " + std::to_string(reachedCount) + " state values\n";
+
+	for (auto valueId : m_registry.GetMostFrequentStates(topCount))
+	{
+		auto& hits = stateHits[valueId];
+		outString += "State Value " + std::to_string(valueId);
+
+		if constexpr (!StatePolicy::IsCombined)
+			outString += " (" + std::string(m_registry.IsInputState(valueId) ? "Input" : "Output") + ")";
+
+		outString += ": " + std::to_string(hits.count) + " hits"
+			+ ", first " + std::to_string(hits.firstTimestamp * 1e-6f) + "s"
+			+ ", last " + std::to_string(hits.lastTimestamp * 1e-6f) + "s\n{";
+		outString += m_registry.PrintStateValues(valueId);
+		outString += "\n}\n";
+	}
+
+	return outString;
+}
+
+template class BasicFiniteStateMachine<SeparateStates, IgnoreDuplicates>;
+template class BasicFiniteStateMachine<SeparateStates, CountDuplicates>;
+template class BasicFiniteStateMachine<CombinedStates, IgnoreDuplicates>;
+template class BasicFiniteStateMachine<CombinedStates, CountDuplicates>;
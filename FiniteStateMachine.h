@@ -1,76 +1,262 @@
 #pragma once
+#include "StateGraph.h"
+#include "StateTrace.h"
 #include "StateValuesRegistry.h"
+#include "FrameSource.h"
+#include "FixedLayoutRegistry.h"
 #include <iostream>
 #include <ostream>
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 
-struct State;
+/// <summary>
+/// Time spent in AddFrame
+/// </summary>
+struct FrameLatency
+{
+	uint64_t frameCount = 0;
+	uint64_t totalNanoseconds = 0;
+	uint64_t maxNanoseconds = 0;
+};
 
-struct State
+/// <summary>
+/// Learns a machine of a log. The policies of the state values are resolved at compile time,
+/// all of them are instantiated in FiniteStateMachine.cpp.
+/// </summary>
+template<class StatePolicy = SeparateStates, class DuplicatePolicy = IgnoreDuplicates>
+class BasicFiniteStateMachine
 {
-	using TransitionMap = std::map<std::weak_ptr<State>, std::set<uint64_t>, std::owner_less<std::weak_ptr<State>>>;
+public:
+	using ValueRegistry = BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>;
 
-	std::vector<participant_ptr_t> values;
-	uint64_t index = 0;
-	uint64_t indegree = 0;
-	TransitionMap transitions;
-	std::weak_ptr<State> lowlink;
+public:
+	/// <summary>
+	/// Learns the machine of a log. With more than one thread, binary logs are split into chunks,
+	/// that are learned in parallel and merged into the same machine as a sequential read.
+	/// All other logs are parsed in a pipeline, that overlaps parsing with building the states.
+	/// The retention bounds the timestamps kept while the log is learned.
+	/// </summary>
+	explicit BasicFiniteStateMachine(const std::string& filePath, bool combineStates = true, bool onlyOutput = false, bool streamFrames = false, unsigned int threadCount = 1,
+		const TimestampRetention& retention = {});
 
-	friend std::ostream& operator<<(std::ostream& os, const State& state)
-	{
-		os << std::to_string(state.index)
-			<< " (" << std::to_string(state.indegree) << ")"
-			<< "\t->\t{ ";
-		for (const auto& transition : state.transitions)
-		{
-			os << std::to_string(transition.first.lock()->index) << " ";
-		}
-		os << "}";
-		return os;
-	}
+	/// <summary>
+	/// Learns the machine of any frame source
+	/// </summary>
+	explicit BasicFiniteStateMachine(FrameSource& source, bool combineStates = true, bool onlyOutput = false, unsigned int threadCount = 1,
+		const TimestampRetention& retention = {});
 
-	bool operator()(std::shared_ptr<State> lhs, std::shared_ptr<State> rhs) const
-	{
-		auto& lValues = lhs->values;
-		auto& rValues = rhs->values;
-		auto size = lValues.size() < rValues.size() ? lValues.size() : rValues.size();
+	/// <summary>
+	/// Learns the machine of a source with a process layout known at compile time.
+	/// The state values are resolved with fixed size images. If a direction does not start
+	/// with the participants of the layout, the generic registry takes over.
+	/// </summary>
+	template<class Input, class Output>
+	BasicFiniteStateMachine(FrameSource& source, ProcessLayout<Input, Output> layout, bool combineStates = true, bool onlyOutput = false,
+		const TimestampRetention& retention = {});
+	~BasicFiniteStateMachine();
 
-		for (std::size_t i = 0; i < size; ++i)
-		{
-			auto ordering = lValues[i]->Cmp(*rValues[i]);
-			if (ordering != 0)
-				return ordering < 0;
-		}
+public:
+	/// <summary>
+	/// Learns one more frame of a running process. The frame continues from the last frame learned,
+	/// with the options of the constructor. The graph is thawed for the frames, until FreezeGraph is called.
+	/// </summary>
+	void AddFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes);
 
-		return lValues.size() < rValues.size();
-	}
-};
+	void AddFrames(std::span<const Frame> frames);
 
-class FiniteStateMachine
-{
-public:
-	explicit FiniteStateMachine(const std::string& filePath, bool combineStates = true, bool onlyOutput = false);
-	~FiniteStateMachine();
+	/// <summary>
+	/// Packs the learned states into the graph. Needed after AddFrame, before the passes and the output.
+	/// </summary>
+	void FreezeGraph();
+
+	/// <summary>
+	/// Packs a copy of the current graph for readers on other threads. Called by the learning thread.
+	/// </summary>
+	std::shared_ptr<const StateGraph> PublishSnapshot();
+
+	/// <summary>
+	/// The last published graph, safe to call while frames are added
+	/// </summary>
+	std::shared_ptr<const StateGraph> GetSnapshot() const;
+
+	const FrameLatency& GetFrameLatency() const;
+
+	/// <summary>
+	/// Sets the timestamps kept from now on, the transitions drop the timestamps outside of it at once.
+	/// The structural passes work under every retention. Without all timestamps no trace is recorded, RemoveInputStates
+	/// merges the transitions instead of replaying them, RelativeTimes, PrintTimes and PrintTimeAutomata cover the kept timestamps,
+	/// and the statistics of collapsed sequences take the mean times of their steps.
+	/// </summary>
+	void SetRetention(const TimestampRetention& retention);
+
+	const TimestampRetention& GetRetention() const;
+
+	/// <summary>
+	/// Memory of the states with their state values, the transitions, the timestamps and the trace
+	/// </summary>
+	MemoryUsage GetMemoryUsage() const;
 
 protected:
+	/// <summary>
+	/// Empty machine, that learns one chunk of a log
+	/// </summary>
+	BasicFiniteStateMachine() = default;
+
+	/// <summary>
+	/// Runs the reader, the registry and the graph insertion in three stages,
+	/// that pass batches of frames through lock free queues
+	/// </summary>
+	void ReadPipelined(FrameSource& source, bool onlyOutput, bool combineStates);
+
+	/// <summary>
+	/// Builds the states of all frames with the fixed layout registry,
+	/// until a frame does not match the layout
+	/// </summary>
+	template<class Layout>
+	void ReadFixedLayout(FrameSource& source, bool onlyOutput, bool combineStates);
+
+	/// <summary>
+	/// Builds the states of all frames, sequentially or pipelined
+	/// </summary>
+	void ReadSource(FrameSource& source, bool onlyOutput, bool combineStates, unsigned int threadCount);
+
+	/// <summary>
+	/// Moves the graph back into the builder, to continue learning
+	/// </summary>
+	void ThawGraph();
+
+	/// <summary>
+	/// Learns the chunks of a binary log in parallel and merges them in order
+	/// </summary>
+	void ReadChunks(const std::string& filePath, bool onlyOutput, bool combineStates, unsigned int threadCount);
+
+	/// <summary>
+	/// Appends the states and transitions of the next chunk.
+	/// The last state of the previous chunk is connected to the first state of the shard.
+	/// </summary>
+	void MergeShard(BasicFiniteStateMachine& shard, uint32_t shardLastState, const uint64_t& firstTimestamp, uint32_t& previousState, bool combineStates);
+
+	/// <summary>
+	/// Returns the state of the values or creates a new one
+	/// </summary>
+	uint32_t FindOrAddState(uint32_t valueId, bool combineStatesWithDuplicateValues);
+
 	void AddState(
-		std::weak_ptr<State>& prevState,
+		uint32_t& prevState,
 		const uint64_t& timestamp,
 		bool isInput,
-		const std::vector<Change>& changes,
+		std::span<const Change> changes,
 		bool combineStatesWithDuplicateValues
 	);
 
+	/// <summary>
+	/// Adds the state of values, that are already resolved by the registry
+	/// </summary>
+	void AddStateValue(uint32_t& prevState, const uint64_t& timestamp, uint32_t valueId, bool combineStatesWithDuplicateValues);
+
+	/// <summary>
+	/// Inserts the timestamp of a transition and adds its duration to the statistics,
+	/// or only adds the duration without timestamps
+	/// </summary>
+	void AddTimestamp(TransitionTimes& times, const uint64_t& timestamp, const uint64_t& duration);
+
+	/// <summary>
+	/// Drops the timestamps of a transition outside of the retention
+	/// </summary>
+	void TrimTimestamps(TransitionTimes& times);
+
+	/// <summary>
+	/// False, if the retention or the memory budget drop timestamps
+	/// </summary>
+	bool IsKeepingAllTimestamps() const;
+
+	/// <summary>
+	/// The oldest timestamp inside the time window
+	/// </summary>
+	uint64_t GetRetainedSince() const;
+
+	/// <summary>
+	/// Keeps fewer timestamps per transition, until the machine fits into the memory budget
+	/// </summary>
+	void EnforceMemoryBudget();
+
+	/// <summary>
+	/// EnforceMemoryBudget with the image bytes of the registry last passed to the machine,
+	/// so the insert stage of the pipeline does not read the registry the resolve stage changes
+	/// </summary>
+	void TrimToMemoryBudget();
+
+	MemoryUsage GetMemoryUsage(std::size_t registryBytes) const;
+
+	/// <summary>
+	/// Connects the outputs through the input states between them, when the kept timestamps can not replay the run
+	/// </summary>
+	void RemoveInputStatesWithoutReplay() requires (!StatePolicy::IsCombined);
+
+	/// <summary>
+	/// The run through the current states. As long as no pass changed them, it is the trace recorded while learning,
+	/// otherwise it is replayed from the timestamps into replayed.
+	/// </summary>
+	const StateTrace& GetTrace(StateTrace& replayed) const;
+
+	/// <summary>
+	/// Stops recording the trace, once a pass changed the states or the retention drops timestamps
+	/// </summary>
+	void DropTrace();
+
+	/// <summary>
+	/// One step of the run with the time since the previous step
+	/// </summary>
+	struct RunStep
+	{
+		uint32_t transition;
+		uint64_t timestamp;
+		uint64_t duration;
+	};
+
+	/// <summary>
+	/// The steps of the run grouped by their transition in the order of the graph,
+	/// the steps of a transition are between offsets[transition] and offsets[transition + 1].
+	/// </summary>
+	void GetRunSteps(std::vector<RunStep>& steps, std::vector<std::size_t>& offsets) const;
+
+	/// <summary>
+	/// Rebuilds the statistics of every transition from the replayed run, after a pass collapsed several steps into one.
+	/// Without all timestamps the statistics stay as the pass merged them.
+	/// </summary>
+	void SummarizeRun();
+
+	/// <summary>
+	/// Binary search in the states ordered by index
+	/// </summary>
+	std::vector<uint32_t>::const_iterator FindByIndex(const std::vector<uint32_t>& sortedByNumber, const uint64_t& stateIndex) const;
+
 public:
 	uint64_t GetStateCount();
 
+	/// <summary>
+	/// Number of frames the machine was learned from
+	/// </summary>
+	uint64_t GetFrameCount() const;
+
+	/// <summary>
+	/// The state values learned by this machine
+	/// </summary>
+	const ValueRegistry& GetRegistry() const;
+
+	/// <summary>
+	/// The frozen graph of the learned states
+	/// </summary>
+	const StateGraph& GetGraph() const;
+
 	uint64_t CombineSequences();
 
-#ifndef COMBINED_STATES
-	void RemoveInputStates();
-#endif
+	void RemoveInputStates() requires (!StatePolicy::IsCombined);
 
 	uint64_t CombineSCC();
 
@@ -86,8 +272,19 @@ public:
 
 	std::string GetTransitionTimes(const uint64_t& stateIndex) const;
 
+	/// <summary>
+	/// Prints the statistics of the durations of every transition of a state, read in constant time per transition
+	/// </summary>
+	std::string GetTransitionStatistics(const uint64_t& stateIndex) const;
+
 	std::string PrintTimes() const;
 
+	/// <summary>
+	/// Prints the number of duplicates and the most frequent state values with their hits
+	/// and the first and last time they were reached
+	/// </summary>
+	std::string PrintDuplicates(std::size_t topCount = 10) const requires DuplicatePolicy::IsCounted;
+
 	std::string PrintTimeAutomata(
 		const uint64_t& startIndex = 0,
 		const uint64_t& finalIndex = 0,
@@ -111,16 +308,110 @@ public:
 	);
 
 public:
-	friend std::ostream& operator<<(std::ostream& os, const FiniteStateMachine& fsm)
+	friend std::ostream& operator<<(std::ostream& os, const BasicFiniteStateMachine& fsm)
 	{
-		for (auto& state : fsm.m_stateContainer)
-			os << *state << std::endl;
+		auto& graph = fsm.m_graph;
+		for (uint32_t state = 0; state < graph.GetStateCount(); ++state)
+		{
+			os << std::to_string(graph.GetState(state).index)
+				<< " (" << std::to_string(graph.GetState(state).indegree) << ")"
+				<< "\t->\t{ ";
+			for (auto transition = graph.TransitionsBegin(state); transition != graph.TransitionsEnd(state); ++transition)
+				os << std::to_string(graph.GetState(graph.GetTarget(transition)).index) << " ";
+			os << "}" << std::endl;
+		}
 		return os;
 	}
 
 protected:
-	std::shared_ptr<State> m_startState;
-	std::set<std::shared_ptr<State>, State> m_stateContainer;
+	ValueRegistry m_registry;
+	// Only used while the frames are read, frozen into the graph afterwards
+	StateGraphBuilder m_builder;
+	StateGraph m_graph;
+	// The combined state of every state value id
+	std::vector<uint32_t> m_statesByValue;
+	uint64_t m_frameCount = 0;
+
+	// Learning state, kept to continue with AddFrame
+	bool m_combineStates = true;
+	bool m_onlyOutput = false;
+	bool m_isLearning = true;
+	uint32_t m_previousState = StateGraph::NoState;
+	// The time the run entered the previous state, the start state is entered at 0 like in RelativeTimes
+	uint64_t m_previousTimestamp = 0;
+	uint32_t m_previousValueId = ValueRegistry::NoState;
+	FrameLatency m_frameLatency;
+
+	TimestampRetention m_retention;
+	// Timestamps kept per transition, lowered by the memory budget
+	std::size_t m_timestampLimit = SIZE_MAX;
+	uint64_t m_latestTimestamp = 0;
+	// Bytes of the graph at the last check of the budget and the growth of the frames since
+	std::size_t m_budgetedBytes = 0;
+	// Image bytes of the registry at the last frame, passed by the resolve stage in the pipeline
+	std::size_t m_registryImageBytes = 0;
+
+	// The states of all frames in order, while it matches the states of the graph
+	StateTrace m_trace;
+	bool m_isTraceRecorded = true;
+
+	mutable std::mutex m_snapshotMutex;
+	std::shared_ptr<const StateGraph> m_snapshot;
 };
 
-using FSM = FiniteStateMachine;
\ No newline at end of file
+template<class StatePolicy, class DuplicatePolicy>
+template<class Input, class Output>
+BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::BasicFiniteStateMachine(FrameSource& source, ProcessLayout<Input, Output> /*layout*/, bool combineStates /*= true*/, bool onlyOutput /*= false*/,
+	const TimestampRetention& retention /*= {}*/)
+	: m_combineStates(combineStates)
+	, m_onlyOutput(onlyOutput)
+{
+	SetRetention(retention);
+	ReadFixedLayout<ProcessLayout<Input, Output>>(source, onlyOutput, combineStates);
+	FreezeGraph();
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+template<class Layout>
+void BasicFiniteStateMachine<StatePolicy, DuplicatePolicy>::ReadFixedLayout(FrameSource& source, bool onlyOutput, bool combineStates)
+{
+	FixedLayoutRegistry<Layout, StatePolicy, DuplicatePolicy> registry;
+	bool isFixed = true;
+
+	bool success = source.ReadFrames([&](std::span<const Frame> frames)
+		{
+			for (auto& frame : frames)
+			{
+				if (onlyOutput && frame.isInput)
+					continue;
+
+				if (isFixed && !registry.Accepts(frame.isInput, frame.changes))
+				{
+					// The generic registry continues with the values resolved so far
+					registry.CopyTo(m_registry);
+					registry = FixedLayoutRegistry<Layout, StatePolicy, DuplicatePolicy>();
+					isFixed = false;
+				}
+
+				if (isFixed)
+				{
+					++m_frameCount;
+					auto valueId = registry.GetStateValues(frame.isInput, frame.changes);
+					if (m_retention.memoryBudget != 0)
+						m_registryImageBytes = registry.GetImageByteCount();
+					AddStateValue(m_previousState, frame.timestamp, valueId, combineStates);
+				}
+				else
+					AddState(m_previousState, frame.timestamp, frame.isInput, frame.changes, combineStates);
+			}
+		});
+
+	if (!success)
+		throw std::runtime_error(source.GetError());
+
+	if (isFixed)
+		registry.CopyTo(m_registry);
+}
+
+using FiniteStateMachine = BasicFiniteStateMachine<>;
+using FSM = FiniteStateMachine;
@@ -0,0 +1,409 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include "ImageKernels.h"
+#include <array>
+#include <cstring>
+#include <utility>
+
+/// <summary>
+/// Participants of one direction, known at compile time. The byte counts are indexed by the negated
+/// participant id, a byte count of 0 leaves the participant out.
+/// </summary>
+template<unsigned int... ByteCounts>
+struct ParticipantLayout
+{
+	static constexpr std::size_t ParticipantCount = sizeof...(ByteCounts);
+	static constexpr std::array<unsigned int, ParticipantCount> ByteCount = { ByteCounts... };
+	static constexpr std::size_t ImageSize = (std::size_t(0) + ... + ByteCounts);
+
+	static_assert(ParticipantCount > 0 && ByteCount[ParticipantCount - 1] != 0,
+		"The layout ends with its last participant");
+	static_assert(ParticipantCount <= Registry::DenseIndexLimit,
+		"The generic registry indexes the participants of the layout by their negated id");
+
+	static constexpr std::array<std::size_t, ParticipantCount> Offset = []
+		{
+			std::array<std::size_t, ParticipantCount> offsets{};
+			std::size_t offset = 0;
+			for (std::size_t i = 0; i < ParticipantCount; ++i)
+			{
+				offsets[i] = offset;
+				offset += ByteCount[i];
+			}
+			return offsets;
+		}();
+
+	using Image = std::array<unsigned char, ImageSize>;
+
+	/// <summary>
+	/// Calls the visitor with the index of the participant as a compile time constant.
+	/// Indices outside of the layout are ignored.
+	/// </summary>
+	template<class Visitor>
+	static void Visit(uint16_t idx, Visitor&& visitor)
+	{
+		Visit(idx, visitor, std::make_index_sequence<ParticipantCount>());
+	}
+
+	/// <summary>
+	/// If the first frame of a direction has exactly the participants of the layout
+	/// </summary>
+	static bool Matches(std::span<const Change> changes)
+	{
+		std::array<bool, ParticipantCount> isSeen{};
+		for (auto& change : changes)
+		{
+			auto idx = static_cast<uint16_t>(0 - change.participantId);
+			if (idx >= ParticipantCount || ByteCount[idx] == 0 || change.byteCount != ByteCount[idx])
+				return false;
+			isSeen[idx] = true;
+		}
+
+		for (std::size_t i = 0; i < ParticipantCount; ++i)
+			if (ByteCount[i] != 0 && !isSeen[i])
+				return false;
+
+		return true;
+	}
+
+private:
+	template<class Visitor, std::size_t... I>
+	static void Visit(uint16_t idx, Visitor& visitor, std::index_sequence<I...>)
+	{
+		(void)((idx == I && (visitor(std::integral_constant<std::size_t, I>()), true)) || ...);
+	}
+};
+
+/// <summary>
+/// The participant layouts of the inputs and outputs of a plant
+/// </summary>
+template<class Input, class Output>
+struct ProcessLayout
+{
+	using InputLayout = Input;
+	using OutputLayout = Output;
+};
+
+/// <summary>
+/// Hash table interning images of a size known at compile time, so comparing them unrolls
+/// </summary>
+template<std::size_t Size>
+class FixedImageTable
+{
+public:
+	using Image = std::array<unsigned char, Size>;
+
+public:
+	/// <summary>
+	/// Looks up the image and inserts it, if it is new
+	/// </summary>
+	/// <returns>The id of the image and if it was inserted</returns>
+	std::pair<uint32_t, bool> Intern(const Image& image, uint64_t hash)
+	{
+		// Keep the load factor below one half
+		if ((m_images.size() + 1) * 2 > m_slots.size())
+			Grow();
+
+		const std::size_t mask = m_slots.size() - 1;
+		std::size_t slot = static_cast<std::size_t>(hash) & mask;
+
+		while (m_slots[slot] != 0)
+		{
+			uint32_t id = m_slots[slot] - 1;
+			if (m_hashes[id] == hash && m_images[id] == image)
+				return { id, false };
+
+			slot = (slot + 1) & mask;
+		}
+
+		uint32_t id = static_cast<uint32_t>(m_images.size());
+		m_slots[slot] = id + 1;
+		m_hashes.push_back(hash);
+		m_images.push_back(image);
+
+		return { id, true };
+	}
+
+	const Image& GetImage(uint32_t id) const
+	{
+		return m_images[id];
+	}
+
+	/// <summary>
+	/// The hash the image was interned with
+	/// </summary>
+	uint64_t GetHash(uint32_t id) const
+	{
+		return m_hashes[id];
+	}
+
+	std::size_t GetImageCount() const
+	{
+		return m_images.size();
+	}
+
+	std::size_t GetByteCount() const
+	{
+		return m_images.capacity() * Size + m_hashes.capacity() * sizeof(uint64_t) + m_slots.capacity() * sizeof(uint32_t);
+	}
+
+private:
+	void Grow()
+	{
+		std::vector<uint32_t> slots(m_slots.empty() ? 64 : m_slots.size() * 2, 0);
+		const std::size_t mask = slots.size() - 1;
+
+		for (uint32_t id = 0; id < m_hashes.size(); ++id)
+		{
+			std::size_t slot = static_cast<std::size_t>(m_hashes[id]) & mask;
+			while (slots[slot] != 0)
+				slot = (slot + 1) & mask;
+			slots[slot] = id + 1;
+		}
+
+		m_slots.swap(slots);
+	}
+
+private:
+	std::vector<Image> m_images;
+	std::vector<uint64_t> m_hashes;
+	// Open addressing with linear probing, a slot holds id + 1 or 0 if empty
+	std::vector<uint32_t> m_slots;
+};
+
+/// <summary>
+/// Resolves state values like StateValuesRegistry, for a process layout known at compile time.
+/// The process images are fixed size arrays and every participant is copied, compared and hashed
+/// with its size known at compile time. The state value ids and the hashes are the same as
+/// the ones of the generic registry with the same policies, so it can take over at any frame.
+/// </summary>
+template<class Layout, class StatePolicy = SeparateStates, class DuplicatePolicy = IgnoreDuplicates>
+class FixedLayoutRegistry
+{
+public:
+	using InputLayout = typename Layout::InputLayout;
+	using OutputLayout = typename Layout::OutputLayout;
+
+public:
+	/// <summary>
+	/// If the frame can be resolved with the layout. The first frame of every direction
+	/// has to match the layout, all later frames are accepted.
+	/// </summary>
+	bool Accepts(bool isInput, std::span<const Change> changes) const
+	{
+		if (isInput)
+			return m_input.isInitialized || InputLayout::Matches(changes);
+		return m_output.isInitialized || OutputLayout::Matches(changes);
+	}
+
+	/// <summary>
+	/// Applies the changes of an accepted frame and returns the id of the resulting state values
+	/// </summary>
+	/// <returns>The state value id or NoState, if the values are not complete yet</returns>
+	uint32_t GetStateValues(bool isInput, std::span<const Change> changes)
+	{
+		if (isInput)
+			ChangeValues(m_input, changes);
+		else
+			ChangeValues(m_output, changes);
+
+		if constexpr (StatePolicy::IsCombined)
+		{
+			if (!m_input.isInitialized || !m_output.isInitialized)
+				return StateValuesRegistry::NoState;
+
+			// Both images are interned, so the pair of their ids identifies the combined state
+			uint32_t imageIds[2] = { FindCurrentValues(m_input, true), FindCurrentValues(m_output, false) };
+
+			CombinedImage combinedImage;
+			memcpy(combinedImage.data(), imageIds, sizeof(imageIds));
+
+			auto [imageId, isNew] = m_combinedImages.Intern(combinedImage, ImageKernels::Hash<sizeof(CombinedImage)>(combinedImage.data()));
+			if (isNew)
+				m_stateImages.push_back({ true, imageId });
+
+			return imageId;
+		}
+		else
+			return isInput ? FindCurrentValues(m_input, true) : FindCurrentValues(m_output, false);
+	}
+
+	/// <summary>
+	/// Memory of the images of both directions and the state values, like the image bytes of the generic registry
+	/// </summary>
+	std::size_t GetImageByteCount() const
+	{
+		auto directionBytes = [](const auto& direction)
+		{
+			return direction.images.GetByteCount() + direction.stateValueIds.capacity() * sizeof(uint32_t);
+		};
+
+		return directionBytes(m_input) + directionBytes(m_output)
+			+ m_combinedImages.GetByteCount()
+			+ m_stateImages.capacity() * sizeof(StateImage);
+	}
+
+	/// <summary>
+	/// Fills an empty generic registry with the state values resolved so far,
+	/// so it continues as if it had resolved all frames itself
+	/// </summary>
+	void CopyTo(BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>& registry) const
+	{
+		CopyDirection(registry.m_inputRegistry, m_input);
+		CopyDirection(registry.m_outputRegistry, m_output);
+
+		registry.m_stateImages.clear();
+		for (auto& stateImage : m_stateImages)
+			registry.m_stateImages.push_back({ stateImage.isInput, stateImage.imageId });
+
+		if constexpr (StatePolicy::IsCombined)
+		{
+			registry.m_combinedImages.SetImageSize(sizeof(CombinedImage));
+			for (uint32_t id = 0; id < m_combinedImages.GetImageCount(); ++id)
+				registry.m_combinedImages.Intern(m_combinedImages.GetImage(id).data(), m_combinedImages.GetHash(id));
+		}
+
+		registry.m_duplicateStates = m_duplicateStates;
+	}
+
+private:
+	template<class DirectionLayout>
+	struct Direction
+	{
+		using ParticipantHashes = std::array<uint64_t, DirectionLayout::ParticipantCount>;
+
+		Direction()
+		{
+			// The image starts with zeros, like the image of the generic registry
+			for (uint16_t i = 0; i < DirectionLayout::ParticipantCount; ++i)
+			{
+				seeds[i] = ImageKernels::Hash<sizeof(i)>(reinterpret_cast<const unsigned char*>(&i));
+				if (DirectionLayout::ByteCount[i] == 0)
+					continue;
+
+				participantHashes[i] = ImageKernels::Hash(image.data() + DirectionLayout::Offset[i], DirectionLayout::ByteCount[i], seeds[i]);
+				hash ^= participantHashes[i];
+			}
+		}
+
+		bool isInitialized = false;
+		typename DirectionLayout::Image image{};
+		// The rolling hash of the generic registry, with the seed of every participant
+		uint64_t hash = 0;
+		ParticipantHashes participantHashes{};
+		ParticipantHashes seeds{};
+		FixedImageTable<DirectionLayout::ImageSize> images;
+		// The state value id of every image
+		std::vector<uint32_t> stateValueIds;
+	};
+
+	struct StateImage
+	{
+		bool isInput;
+		uint32_t imageId;
+	};
+
+	using CombinedImage = std::array<unsigned char, 2 * sizeof(uint32_t)>;
+
+private:
+	template<class DirectionLayout>
+	static void ChangeValues(Direction<DirectionLayout>& direction, std::span<const Change> changes)
+	{
+		direction.isInitialized = true;
+
+		for (auto& change : changes)
+		{
+			DirectionLayout::Visit(static_cast<uint16_t>(0 - change.participantId), [&direction, &change](auto participant)
+				{
+					constexpr std::size_t idx = decltype(participant)::value;
+					constexpr unsigned int byteCount = DirectionLayout::ByteCount[idx];
+					if constexpr (byteCount != 0)
+					{
+						auto participantBytes = direction.image.data() + DirectionLayout::Offset[idx];
+
+						// Unchanged participants keep their hash
+						if (change.byteCount >= byteCount)
+						{
+							if (memcmp(participantBytes, change.bytes, byteCount) == 0)
+								return;
+							memcpy(participantBytes, change.bytes, byteCount);
+						}
+						else
+						{
+							if (memcmp(participantBytes, change.bytes, change.byteCount) == 0)
+								return;
+							memcpy(participantBytes, change.bytes, change.byteCount);
+						}
+
+						auto participantHash = ImageKernels::Hash<byteCount>(participantBytes, direction.seeds[idx]);
+						direction.hash ^= direction.participantHashes[idx] ^ participantHash;
+						direction.participantHashes[idx] = participantHash;
+					}
+				});
+		}
+	}
+
+	template<class DirectionLayout>
+	uint32_t FindCurrentValues(Direction<DirectionLayout>& direction, bool isInput)
+	{
+		auto [imageId, isNew] = direction.images.Intern(direction.image, direction.hash);
+
+		if constexpr (DuplicatePolicy::IsCounted)
+		{
+			if (!isNew)
+				++m_duplicateStates;
+		}
+
+		if constexpr (StatePolicy::IsCombined)
+		{
+			(void)isInput;
+			return imageId;
+		}
+		else
+		{
+			if (isNew)
+			{
+				direction.stateValueIds.push_back(static_cast<uint32_t>(m_stateImages.size()));
+				m_stateImages.push_back({ isInput, imageId });
+			}
+
+			return direction.stateValueIds[imageId];
+		}
+	}
+
+	template<class DirectionLayout>
+	static void CopyDirection(Registry& registry, const Direction<DirectionLayout>& direction)
+	{
+		if (!direction.isInitialized)
+			return;
+
+		registry.participantCount = static_cast<uint32_t>(DirectionLayout::ParticipantCount);
+		registry.denseCount = registry.participantCount;
+		registry.slots.assign(DirectionLayout::ParticipantCount, {});
+		registry.participantIds.resize(DirectionLayout::ParticipantCount);
+		for (std::size_t i = 0; i < DirectionLayout::ParticipantCount; ++i)
+		{
+			registry.slots[i] = { DirectionLayout::Offset[i], DirectionLayout::ByteCount[i], DirectionLayout::ByteCount[i] != 0 };
+			registry.participantIds[i] = static_cast<unsigned short>(0 - i);
+		}
+
+		registry.image.assign(direction.image.begin(), direction.image.end());
+		registry.hash = direction.hash;
+		registry.participantHashes.assign(direction.participantHashes.begin(), direction.participantHashes.end());
+
+		// Both registries use the same hashes, so the images are interned in order without hashing them again
+		registry.images.SetImageSize(DirectionLayout::ImageSize);
+		for (uint32_t id = 0; id < direction.images.GetImageCount(); ++id)
+			registry.images.Intern(direction.images.GetImage(id).data(), direction.images.GetHash(id));
+
+		registry.stateValueIds = direction.stateValueIds;
+	}
+
+private:
+	Direction<InputLayout> m_input;
+	Direction<OutputLayout> m_output;
+	// Only used by combined states
+	FixedImageTable<sizeof(CombinedImage)> m_combinedImages;
+	std::vector<StateImage> m_stateImages;
+	unsigned int m_duplicateStates = 0;
+};
@@ -0,0 +1,92 @@
+#include "FrameBatch.h"
+
+FrameBatch::FrameBatch(bool copyBytes /*= true*/)
+	: m_copyBytes(copyBytes)
+{
+	m_frames.reserve(Capacity);
+	m_valueIds.reserve(Capacity);
+	m_changeOffsets.reserve(Capacity + 1);
+	m_changeOffsets.push_back(0);
+}
+
+void FrameBatch::Append(const uint64_t& timestamp, bool isInput, std::span<const Change> changes)
+{
+	m_frames.push_back({ timestamp, isInput, {} });
+	m_valueIds.push_back(StateValuesRegistry::NoState);
+
+	for (auto& change : changes)
+	{
+		m_changes.push_back(change);
+
+		if (m_copyBytes)
+		{
+			m_byteOffsets.push_back(m_bytes.size());
+			m_bytes.insert(m_bytes.end(), change.bytes, change.bytes + change.byteCount);
+		}
+	}
+
+	m_changeOffsets.push_back(m_changes.size());
+}
+
+std::span<const Frame> FrameBatch::Complete()
+{
+	if (m_copyBytes)
+	{
+		for (std::size_t i = 0; i < m_changes.size(); ++i)
+			m_changes[i].bytes = m_bytes.data() + m_byteOffsets[i];
+	}
+
+	for (std::size_t frame = 0; frame < m_frames.size(); ++frame)
+	{
+		m_frames[frame].changes = std::span<const Change>(
+			m_changes.data() + m_changeOffsets[frame],
+			m_changeOffsets[frame + 1] - m_changeOffsets[frame]);
+	}
+
+	return m_frames;
+}
+
+std::span<const Frame> FrameBatch::GetFrames() const
+{
+	return m_frames;
+}
+
+void FrameBatch::Clear()
+{
+	m_frames.clear();
+	m_valueIds.clear();
+	m_changeOffsets.resize(1);
+	m_changes.clear();
+	m_byteOffsets.clear();
+	m_bytes.clear();
+}
+
+std::size_t FrameBatch::GetFrameCount() const
+{
+	return m_frames.size();
+}
+
+bool FrameBatch::IsFull() const
+{
+	return m_frames.size() >= Capacity;
+}
+
+uint32_t FrameBatch::GetValueId(std::size_t frame) const
+{
+	return m_valueIds[frame];
+}
+
+void FrameBatch::SetValueId(std::size_t frame, uint32_t valueId)
+{
+	m_valueIds[frame] = valueId;
+}
+
+std::size_t FrameBatch::GetRegistryByteCount() const
+{
+	return m_registryByteCount;
+}
+
+void FrameBatch::SetRegistryByteCount(std::size_t byteCount)
+{
+	m_registryByteCount = byteCount;
+}
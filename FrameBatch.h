@@ -0,0 +1,74 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// <summary>
+/// One frame of a log. The changes point into the buffers of the batch or the frame source.
+/// </summary>
+struct Frame
+{
+	uint64_t timestamp = 0;
+	bool isInput = false;
+	std::span<const Change> changes;
+};
+
+/// <summary>
+/// Frames collected from a reader, passed to the machine or between the ingestion stages.
+/// The buffers are kept by Clear, so a reused batch does not allocate.
+/// </summary>
+class FrameBatch
+{
+public:
+	static constexpr std::size_t Capacity = 1024;
+
+public:
+	/// <summary>
+	/// The bytes of the changes are copied, if the reader reuses its buffers.
+	/// Otherwise they have to stay valid as long as the batch is used.
+	/// </summary>
+	explicit FrameBatch(bool copyBytes = true);
+
+public:
+	void Append(const uint64_t& timestamp, bool isInput, std::span<const Change> changes);
+
+	/// <summary>
+	/// Points the frames to their changes, after the last frame was appended
+	/// </summary>
+	std::span<const Frame> Complete();
+
+	/// <summary>
+	/// The frames of a completed batch
+	/// </summary>
+	std::span<const Frame> GetFrames() const;
+
+	void Clear();
+
+	std::size_t GetFrameCount() const;
+	bool IsFull() const;
+
+	/// <summary>
+	/// The state values of the frame, set by the resolve stage
+	/// </summary>
+	uint32_t GetValueId(std::size_t frame) const;
+	void SetValueId(std::size_t frame, uint32_t valueId);
+
+	/// <summary>
+	/// The image bytes of the registry after the batch was resolved, so the memory budget is checked without reading the registry
+	/// </summary>
+	std::size_t GetRegistryByteCount() const;
+	void SetRegistryByteCount(std::size_t byteCount);
+
+private:
+	bool m_copyBytes;
+	std::vector<Frame> m_frames;
+	std::vector<uint32_t> m_valueIds;
+	std::size_t m_registryByteCount = 0;
+	// First change of every frame, one more for the end
+	std::vector<std::size_t> m_changeOffsets;
+	std::vector<Change> m_changes;
+	// Copied bytes are referenced by their offset, as the buffer may grow
+	std::vector<std::size_t> m_byteOffsets;
+	std::vector<unsigned char> m_bytes;
+};
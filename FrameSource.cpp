@@ -0,0 +1,177 @@
+#include "FrameSource.h"
+#include "JsonFrameWriter.h"
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+const std::string& FrameSource::GetError() const
+{
+	return m_error;
+}
+
+std::unique_ptr<FrameSource> FrameSource::Open(const std::string& filePath, bool streamFrames /*= false*/)
+{
+	// Binary logs are read straight from a memory mapping
+	if (BinaryFrameLog::IsBinaryLog(filePath))
+		return std::make_unique<BinaryFrameSource>(filePath);
+
+	// Bus captures are decoded without a conversion step
+	if (PcapFrameReader::IsCapture(filePath))
+		return std::make_unique<PcapFrameSource>(filePath);
+
+	// Build the states while the log is parsed, so that the memory is bound by the machine
+	if (streamFrames)
+		return std::make_unique<JsonFrameSource>(filePath);
+
+	return std::make_unique<JsonDocumentFrameSource>(filePath);
+}
+
+bool FrameSource::WriteTo(const std::string& filePath)
+{
+	auto write = [this, &filePath](auto& writer)
+	{
+		if (!writer.IsOpen())
+		{
+			m_error = "Could not open " + filePath;
+			return false;
+		}
+
+		// The log ends before the first frame it cannot hold
+		bool isWritten = true;
+		bool success = ReadFrames([&writer, &isWritten](std::span<const Frame> frames)
+			{
+				for (auto& frame : frames)
+					isWritten = isWritten && writer.WriteFrame(frame.timestamp, frame.isInput, frame.changes);
+			});
+		writer.Close();
+
+		if (success && !isWritten)
+			m_error = writer.GetError();
+
+		return success && isWritten;
+	};
+
+	if (std::filesystem::path(filePath).extension() == ".ctfl")
+	{
+		BinaryFrameWriter writer(filePath);
+		return write(writer);
+	}
+
+	JsonFrameWriter writer(filePath);
+	return write(writer);
+}
+
+JsonFrameSource::JsonFrameSource(const std::string& filePath)
+	: m_reader(filePath)
+{
+}
+
+bool JsonFrameSource::ReadFrames(const BatchCallback& onBatch)
+{
+	// The parser reuses the buffer of its current frame
+	return ReadBatches(m_reader, true, onBatch);
+}
+
+JsonDocumentFrameSource::JsonDocumentFrameSource(const std::string& filePath)
+	: m_filePath(filePath)
+{
+}
+
+bool JsonDocumentFrameSource::ReadFrames(const BatchCallback& onBatch)
+{
+	std::ifstream f(m_filePath);
+	if (!f.is_open())
+	{
+		m_error = "Could not open " + m_filePath;
+		return false;
+	}
+
+	const json data = json::parse(f);
+	auto& frames = data["frames"];
+
+	FrameBatch batch;
+	std::vector<Change> changes;
+	std::vector<unsigned char> frameBytes;
+
+	for (auto& frame : frames)
+	{
+		changes.clear();
+		frameBytes.clear();
+
+		for (auto& data : frame["data"])
+		{
+			unsigned int byteSize = data["byte"].size();
+			changes.push_back(
+				{
+					data["participant"].get<unsigned short>(),
+					byteSize
+				});
+
+			for (auto& byte : data["byte"])
+				frameBytes.push_back(byte.get<unsigned char>());
+		}
+
+		// The buffer is complete, so the changes can point into it
+		std::size_t offset = 0;
+		for (auto& change : changes)
+		{
+			change.bytes = frameBytes.data() + offset;
+			offset += change.byteCount;
+		}
+
+		batch.Append(frame["timestamp"].get<uint64_t>(), frame["input/output"].get<bool>(), changes);
+
+		if (batch.IsFull())
+		{
+			onBatch(batch.Complete());
+			batch.Clear();
+		}
+	}
+
+	if (batch.GetFrameCount() != 0)
+		onBatch(batch.Complete());
+
+	return true;
+}
+
+BinaryFrameSource::BinaryFrameSource(const std::string& filePath)
+	: m_reader(filePath)
+{
+}
+
+bool BinaryFrameSource::ReadFrames(const BatchCallback& onBatch)
+{
+	return ReadBatches(m_reader, false, onBatch);
+}
+
+PcapFrameSource::PcapFrameSource(const std::string& filePath)
+	: m_reader(filePath)
+{
+}
+
+bool PcapFrameSource::ReadFrames(const BatchCallback& onBatch)
+{
+	return ReadBatches(m_reader, false, onBatch);
+}
+
+MemoryFrameSource::MemoryFrameSource()
+	: m_frames(true)
+{
+}
+
+void MemoryFrameSource::AddFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes)
+{
+	m_frames.Append(timestamp, isInput, changes);
+}
+
+bool MemoryFrameSource::ReadFrames(const BatchCallback& onBatch)
+{
+	auto frames = m_frames.Complete();
+
+	for (std::size_t first = 0; first < frames.size(); first += FrameBatch::Capacity)
+		onBatch(frames.subspan(first, std::min(FrameBatch::Capacity, frames.size() - first)));
+
+	return true;
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include "FrameBatch.h"
+#include "BinaryFrameLog.h"
+#include "JsonFrameReader.h"
+#include "PcapFrameReader.h"
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+
+/// <summary>
+/// Yields the frames of a log in batches.
+/// The frames and the bytes of their changes are only valid during the callback, as the buffers are reused.
+/// </summary>
+class FrameSource
+{
+public:
+	using BatchCallback = std::function<void(std::span<const Frame> frames)>;
+
+public:
+	virtual ~FrameSource() = default;
+
+	/// <summary>
+	/// Reads the log and calls onBatch for every batch of frames in order
+	/// </summary>
+	/// <returns>false, if the log could not be read</returns>
+	virtual bool ReadFrames(const BatchCallback& onBatch) = 0;
+
+	const std::string& GetError() const;
+
+	/// <summary>
+	/// Opens the source of a log file by its format.
+	/// JSON logs are parsed as a whole, unless streamFrames is set.
+	/// </summary>
+	static std::unique_ptr<FrameSource> Open(const std::string& filePath, bool streamFrames = false);
+
+	/// <summary>
+	/// Writes all frames into a log file, a binary frame log for the extension .ctfl and a JSON event log otherwise
+	/// </summary>
+	/// <returns>false, if the frames could not be read or the file not be written</returns>
+	bool WriteTo(const std::string& filePath);
+
+protected:
+	/// <summary>
+	/// Collects the frames of a reader with a frame callback into batches
+	/// </summary>
+	template<typename Reader>
+	bool ReadBatches(Reader& reader, bool copyBytes, const BatchCallback& onBatch)
+	{
+		FrameBatch batch(copyBytes);
+
+		bool success = reader.ReadFrames([&](const uint64_t& timestamp, bool isInput, const std::vector<Change>& changes)
+			{
+				batch.Append(timestamp, isInput, changes);
+
+				if (batch.IsFull())
+				{
+					onBatch(batch.Complete());
+					batch.Clear();
+				}
+			});
+
+		if (!success)
+		{
+			m_error = reader.GetError();
+			return false;
+		}
+
+		if (batch.GetFrameCount() != 0)
+			onBatch(batch.Complete());
+
+		return true;
+	}
+
+protected:
+	std::string m_error;
+};
+
+/// <summary>
+/// Streams a JSON event log, only the current batch is kept in memory
+/// </summary>
+class JsonFrameSource : public FrameSource
+{
+public:
+	explicit JsonFrameSource(const std::string& filePath);
+
+	bool ReadFrames(const BatchCallback& onBatch) override;
+
+private:
+	JsonFrameReader m_reader;
+};
+
+/// <summary>
+/// Parses a JSON event log as a whole document before the frames are read
+/// </summary>
+class JsonDocumentFrameSource : public FrameSource
+{
+public:
+	explicit JsonDocumentFrameSource(const std::string& filePath);
+
+	bool ReadFrames(const BatchCallback& onBatch) override;
+
+private:
+	std::string m_filePath;
+};
+
+/// <summary>
+/// Binary frame log, the changes point into the memory mapping without a copy
+/// </summary>
+class BinaryFrameSource : public FrameSource
+{
+public:
+	explicit BinaryFrameSource(const std::string& filePath);
+
+	bool ReadFrames(const BatchCallback& onBatch) override;
+
+private:
+	BinaryFrameReader m_reader;
+};
+
+/// <summary>
+/// EtherCAT bus capture, the changes point into the memory mapping without a copy
+/// </summary>
+class PcapFrameSource : public FrameSource
+{
+public:
+	explicit PcapFrameSource(const std::string& filePath);
+
+	bool ReadFrames(const BatchCallback& onBatch) override;
+
+private:
+	PcapFrameReader m_reader;
+};
+
+/// <summary>
+/// Frames held in memory, e.g. to build small machines in tests
+/// </summary>
+class MemoryFrameSource : public FrameSource
+{
+public:
+	MemoryFrameSource();
+
+	/// <summary>
+	/// Copies the frame and its bytes into the source
+	/// </summary>
+	void AddFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes);
+
+	bool ReadFrames(const BatchCallback& onBatch) override;
+
+private:
+	FrameBatch m_frames;
+};
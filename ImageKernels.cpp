@@ -0,0 +1,274 @@
+#include "ImageKernels.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define IMAGE_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles the intrinsics of every level, GCC and Clang need them enabled per function
+#if defined(IMAGE_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	constexpr std::size_t BlockSize = 32;
+	constexpr std::size_t LaneCount = 4;
+	constexpr uint64_t LaneKeys[LaneCount] = { 0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL };
+	// Added to the keys after every block, so equal blocks at different positions hash differently
+	constexpr uint64_t KeyStep = 0x9E3779B97F4A7C15ULL;
+
+	struct Kernels
+	{
+		ImageKernels::Level level;
+		bool (*equal)(const unsigned char*, const unsigned char*, std::size_t);
+		// Accumulates whole blocks into the four lanes, that start with the hash XOR their key
+		void (*hashBlocks)(const unsigned char*, std::size_t, uint64_t, uint64_t*);
+	};
+
+	bool EqualScalar(const unsigned char* a, const unsigned char* b, std::size_t size)
+	{
+		return memcmp(a, b, size) == 0;
+	}
+
+	void HashBlocksScalar(const unsigned char* data, std::size_t blockCount, uint64_t hash, uint64_t* acc)
+	{
+		for (std::size_t lane = 0; lane < LaneCount; ++lane)
+			acc[lane] = hash ^ LaneKeys[lane];
+
+		for (std::size_t block = 0; block < blockCount; ++block, data += BlockSize)
+		{
+			for (std::size_t lane = 0; lane < LaneCount; ++lane)
+			{
+				uint64_t value;
+				memcpy(&value, data + lane * sizeof(uint64_t), sizeof(value));
+				uint64_t keyed = value ^ (LaneKeys[lane] + block * KeyStep);
+				acc[lane] += value + (keyed & 0xFFFFFFFFULL) * (keyed >> 32);
+			}
+		}
+	}
+
+#ifdef IMAGE_KERNELS_X86
+	TARGET_SSE2 bool EqualSse2(const unsigned char* a, const unsigned char* b, std::size_t size)
+	{
+		std::size_t i = 0;
+		for (; i + 64 <= size; i += 64)
+		{
+			// Four independent differences, so the loads do not wait on each other
+			__m128i diff0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+			__m128i diff1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+			__m128i diff2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 32)));
+			__m128i diff3 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 48)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 48)));
+			__m128i diff = _mm_or_si128(_mm_or_si128(diff0, diff1), _mm_or_si128(diff2, diff3));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+				return false;
+		}
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+			if (_mm_movemask_epi8(equal) != 0xFFFF)
+				return false;
+		}
+		return memcmp(a + i, b + i, size - i) == 0;
+	}
+
+	TARGET_SSE2 void HashBlocksSse2(const unsigned char* data, std::size_t blockCount, uint64_t hash, uint64_t* acc)
+	{
+		__m128i keys01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(LaneKeys));
+		__m128i keys23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(LaneKeys + 2));
+		__m128i acc01 = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(hash)), keys01);
+		__m128i acc23 = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(hash)), keys23);
+		const __m128i step = _mm_set1_epi64x(static_cast<long long>(KeyStep));
+
+		for (std::size_t block = 0; block < blockCount; ++block, data += BlockSize)
+		{
+			__m128i value01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+			__m128i value23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+			__m128i keyed01 = _mm_xor_si128(value01, keys01);
+			__m128i keyed23 = _mm_xor_si128(value23, keys23);
+			// Low times high half of every keyed word
+			acc01 = _mm_add_epi64(acc01, _mm_add_epi64(value01, _mm_mul_epu32(keyed01, _mm_srli_epi64(keyed01, 32))));
+			acc23 = _mm_add_epi64(acc23, _mm_add_epi64(value23, _mm_mul_epu32(keyed23, _mm_srli_epi64(keyed23, 32))));
+			keys01 = _mm_add_epi64(keys01, step);
+			keys23 = _mm_add_epi64(keys23, step);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(acc), acc01);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), acc23);
+	}
+
+	TARGET_AVX2 bool EqualAvx2(const unsigned char* a, const unsigned char* b, std::size_t size)
+	{
+		std::size_t i = 0;
+		for (; i + 128 <= size; i += 128)
+		{
+			__m256i diff0 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+			__m256i diff1 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32)));
+			__m256i diff2 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 64)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 64)));
+			__m256i diff3 = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 96)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 96)));
+			__m256i diff = _mm256_or_si256(_mm256_or_si256(diff0, diff1), _mm256_or_si256(diff2, diff3));
+			if (!_mm256_testz_si256(diff, diff))
+				return false;
+		}
+		for (; i + 32 <= size; i += 32)
+		{
+			__m256i diff = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+			if (!_mm256_testz_si256(diff, diff))
+				return false;
+		}
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i diff = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+			if (!_mm_testz_si128(diff, diff))
+				return false;
+		}
+		return memcmp(a + i, b + i, size - i) == 0;
+	}
+
+	TARGET_AVX2 void HashBlocksAvx2(const unsigned char* data, std::size_t blockCount, uint64_t hash, uint64_t* acc)
+	{
+		__m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(LaneKeys));
+		__m256i lanes = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(hash)), keys);
+		const __m256i step = _mm256_set1_epi64x(static_cast<long long>(KeyStep));
+
+		for (std::size_t block = 0; block < blockCount; ++block, data += BlockSize)
+		{
+			__m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+			__m256i keyed = _mm256_xor_si256(value, keys);
+			lanes = _mm256_add_epi64(lanes, _mm256_add_epi64(value, _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32))));
+			keys = _mm256_add_epi64(keys, step);
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), lanes);
+	}
+#endif
+
+	constexpr Kernels ScalarKernels = { ImageKernels::Level::Scalar, EqualScalar, HashBlocksScalar };
+#ifdef IMAGE_KERNELS_X86
+	constexpr Kernels Sse2Kernels = { ImageKernels::Level::Sse2, EqualSse2, HashBlocksSse2 };
+	constexpr Kernels Avx2Kernels = { ImageKernels::Level::Avx2, EqualAvx2, HashBlocksAvx2 };
+#endif
+
+	ImageKernels::Level DetectLevel()
+	{
+#if defined(IMAGE_KERNELS_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool hasSse2 = (info[3] & (1 << 26)) != 0;
+		// AVX needs the OS to save the upper register halves
+		bool hasAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+			&& (_xgetbv(0) & 0x6) == 0x6;
+
+		bool hasAvx2 = false;
+		if (hasAvx && maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			hasAvx2 = (info[1] & (1 << 5)) != 0;
+		}
+
+		if (hasAvx2)
+			return ImageKernels::Level::Avx2;
+		if (hasSse2)
+			return ImageKernels::Level::Sse2;
+#elif defined(IMAGE_KERNELS_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return ImageKernels::Level::Avx2;
+		if (__builtin_cpu_supports("sse2"))
+			return ImageKernels::Level::Sse2;
+#endif
+		return ImageKernels::Level::Scalar;
+	}
+
+	const Kernels& Select(ImageKernels::Level level)
+	{
+#ifdef IMAGE_KERNELS_X86
+		if (level == ImageKernels::Level::Avx2)
+			return Avx2Kernels;
+		if (level == ImageKernels::Level::Sse2)
+			return Sse2Kernels;
+#endif
+		(void)level;
+		return ScalarKernels;
+	}
+
+	// SetLevel may switch the kernels while other threads hash and compare, all levels return the same results
+	std::atomic<const Kernels*>& Selected()
+	{
+		static std::atomic<const Kernels*> kernels = &Select(ImageKernels::GetSupportedLevel());
+		return kernels;
+	}
+
+	const Kernels& Current()
+	{
+		return *Selected().load(std::memory_order_acquire);
+	}
+}
+
+ImageKernels::Level ImageKernels::GetSupportedLevel()
+{
+	static const Level level = DetectLevel();
+	return level;
+}
+
+ImageKernels::Level ImageKernels::GetLevel()
+{
+	return Current().level;
+}
+
+void ImageKernels::SetLevel(Level level)
+{
+	if (level > GetSupportedLevel())
+		level = GetSupportedLevel();
+	Selected().store(&Select(level), std::memory_order_release);
+}
+
+const char* ImageKernels::GetLevelName(Level level)
+{
+	switch (level)
+	{
+	case Level::Avx2:
+		return "AVX2";
+	case Level::Sse2:
+		return "SSE2";
+	default:
+		return "scalar";
+	}
+}
+
+bool ImageKernels::Equal(const unsigned char* a, const unsigned char* b, std::size_t size)
+{
+	return Current().equal(a, b, size);
+}
+
+uint64_t ImageKernels::Hash(const unsigned char* data, std::size_t size, uint64_t seed /*= 0*/)
+{
+	uint64_t hash = (0x9E3779B97F4A7C15ULL + seed) ^ size;
+
+	std::size_t i = 0;
+	if (size >= BlockSize)
+	{
+		uint64_t acc[LaneCount];
+		std::size_t blockCount = size / BlockSize;
+		Current().hashBlocks(data, blockCount, hash, acc);
+
+		for (std::size_t lane = 0; lane < LaneCount; ++lane)
+			hash = Mix(hash ^ acc[lane]);
+		i = blockCount * BlockSize;
+	}
+
+	// Short inputs and the rest of the blocks word by word
+	return HashWords(hash, data + i, size - i);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/// <summary>
+/// Byte kernels over whole process images, with SSE2 and AVX2 versions and a scalar fallback.
+/// The best level of the CPU is chosen at runtime, all levels return the same results.
+/// </summary>
+namespace ImageKernels
+{
+	enum class Level
+	{
+		Scalar,
+		Sse2,
+		Avx2
+	};
+
+	/// <summary>
+	/// The best level supported by the CPU
+	/// </summary>
+	Level GetSupportedLevel();
+
+	Level GetLevel();
+
+	/// <summary>
+	/// Forces a level, e.g. to compare them. Levels above the supported one are lowered to it.
+	/// Other threads may hash meanwhile, a call that already started finishes with the previous level.
+	/// </summary>
+	void SetLevel(Level level);
+
+	const char* GetLevelName(Level level);
+
+	/// <summary>
+	/// Finalizer of MurmurHash3, mixes all bits of a word
+	/// </summary>
+	inline uint64_t Mix(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xFF51AFD7ED558CCDULL;
+		value ^= value >> 33;
+		value *= 0xC4CEB9FE1A85EC53ULL;
+		value ^= value >> 33;
+		return value;
+	}
+
+	/// <summary>
+	/// Word by word part of the hash, inline so it unrolls for sizes known at compile time
+	/// </summary>
+	inline uint64_t HashWords(uint64_t hash, const unsigned char* data, std::size_t size)
+	{
+		std::size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			hash = Mix(hash ^ word);
+		}
+
+		if (i < size)
+		{
+			uint64_t word = 0;
+			memcpy(&word, data + i, size - i);
+			hash = Mix(hash ^ word);
+		}
+
+		return hash;
+	}
+
+	bool Equal(const unsigned char* a, const unsigned char* b, std::size_t size);
+
+	/// <summary>
+	/// 64 bit hash. Inputs of 32 bytes and more are hashed in four independent lanes.
+	/// </summary>
+	uint64_t Hash(const unsigned char* data, std::size_t size, uint64_t seed = 0);
+
+	/// <summary>
+	/// Same as Hash, unrolled for short inputs of a size known at compile time
+	/// </summary>
+	template<std::size_t Size>
+	uint64_t Hash(const unsigned char* data, uint64_t seed = 0)
+	{
+		if constexpr (Size >= 32)
+			return Hash(data, Size, seed);
+		else
+			return HashWords((0x9E3779B97F4A7C15ULL + seed) ^ Size, data, Size);
+	}
+}
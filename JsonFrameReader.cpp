@@ -0,0 +1,207 @@
+#include "JsonFrameReader.h"
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace
+{
+	/// <summary>
+	/// The containers of the log schema, that the handler needs to tell apart
+	/// </summary>
+	enum class Scope
+	{
+		Root,
+		Frames,
+		Frame,
+		Data,
+		Entry,
+		Bytes,
+		Ignored
+	};
+
+	class FrameSaxHandler : public nlohmann::json_sax<json>
+	{
+	public:
+		explicit FrameSaxHandler(const FrameCallback& onFrame)
+			: m_onFrame(onFrame)
+		{
+		}
+
+		bool null() override { return true; }
+
+		bool boolean(bool val) override
+		{
+			if (Top() == Scope::Frame && m_key == "input/output")
+				m_isInput = val;
+			return true;
+		}
+
+		bool number_integer(number_integer_t val) override
+		{
+			return number_unsigned(static_cast<number_unsigned_t>(val));
+		}
+
+		bool number_unsigned(number_unsigned_t val) override
+		{
+			switch (Top())
+			{
+			case Scope::Frame:
+				if (m_key == "timestamp")
+					m_timestamp = val;
+				break;
+			case Scope::Entry:
+				if (m_key == "participant")
+					m_participantId = static_cast<unsigned short>(val);
+				break;
+			case Scope::Bytes:
+				m_bytes.push_back(static_cast<unsigned char>(val));
+				break;
+			default:
+				break;
+			}
+			return true;
+		}
+
+		bool number_float(number_float_t, const string_t&) override { return true; }
+		bool string(string_t&) override { return true; }
+		bool binary(binary_t&) override { return true; }
+
+		bool start_object(std::size_t) override
+		{
+			switch (Top())
+			{
+			case Scope::Frames:
+				m_scopes.push_back(Scope::Frame);
+				m_timestamp = 0;
+				m_isInput = false;
+				m_changes.clear();
+				m_bytes.clear();
+				break;
+			case Scope::Data:
+				m_scopes.push_back(Scope::Entry);
+				m_participantId = 0;
+				m_entryOffset = m_bytes.size();
+				break;
+			default:
+				m_scopes.push_back(m_scopes.empty() ? Scope::Root : Scope::Ignored);
+				break;
+			}
+			return true;
+		}
+
+		bool key(string_t& val) override
+		{
+			m_key = val;
+			return true;
+		}
+
+		bool end_object() override
+		{
+			switch (Top())
+			{
+			case Scope::Frame:
+			{
+				// The buffer is complete, so the changes can point into it
+				std::size_t offset = 0;
+				for (auto& change : m_changes)
+				{
+					change.bytes = m_bytes.data() + offset;
+					offset += change.byteCount;
+				}
+				m_onFrame(m_timestamp, m_isInput, m_changes);
+				break;
+			}
+			case Scope::Entry:
+				m_changes.push_back({ m_participantId, static_cast<unsigned int>(m_bytes.size() - m_entryOffset) });
+				break;
+			default:
+				break;
+			}
+			m_scopes.pop_back();
+			return true;
+		}
+
+		bool start_array(std::size_t) override
+		{
+			auto scope = Top();
+			if (scope == Scope::Root && m_key == "frames")
+				m_scopes.push_back(Scope::Frames);
+			else if (scope == Scope::Frame && m_key == "data")
+				m_scopes.push_back(Scope::Data);
+			else if (scope == Scope::Entry && m_key == "byte")
+				m_scopes.push_back(Scope::Bytes);
+			else
+				m_scopes.push_back(Scope::Ignored);
+			return true;
+		}
+
+		bool end_array() override
+		{
+			m_scopes.pop_back();
+			return true;
+		}
+
+		bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override
+		{
+			m_error = ex.what();
+			return false;
+		}
+
+		const std::string& GetError() const
+		{
+			return m_error;
+		}
+
+	private:
+		Scope Top() const
+		{
+			return m_scopes.empty() ? Scope::Ignored : m_scopes.back();
+		}
+
+	private:
+		const FrameCallback& m_onFrame;
+		std::vector<Scope> m_scopes;
+		std::string m_key;
+		std::string m_error;
+
+		uint64_t m_timestamp = 0;
+		bool m_isInput = false;
+		std::vector<Change> m_changes;
+
+		unsigned short m_participantId = 0;
+		std::size_t m_entryOffset = 0;
+
+		// All bytes of the current frame, reused for every frame
+		std::vector<unsigned char> m_bytes;
+	};
+}
+
+JsonFrameReader::JsonFrameReader(const std::string& filePath)
+	: m_filePath(filePath)
+{
+}
+
+bool JsonFrameReader::ReadFrames(const FrameCallback& onFrame)
+{
+	std::ifstream f(m_filePath);
+	if (!f.is_open())
+	{
+		m_error = "Could not open " + m_filePath;
+		return false;
+	}
+
+	FrameSaxHandler handler(onFrame);
+	bool success = json::sax_parse(f, &handler);
+	f.close();
+
+	if (!success)
+		m_error = handler.GetError();
+
+	return success;
+}
+
+const std::string& JsonFrameReader::GetError() const
+{
+	return m_error;
+}
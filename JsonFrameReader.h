@@ -0,0 +1,25 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include <string>
+
+/// <summary>
+/// Streams the frames of a JSON event log through the SAX interface of nlohmann/json.
+/// Only the frame that is currently parsed is kept in memory.
+/// </summary>
+class JsonFrameReader
+{
+public:
+	explicit JsonFrameReader(const std::string& filePath);
+
+	/// <summary>
+	/// Parses the log and calls onFrame as soon as a frame is complete
+	/// </summary>
+	/// <returns>false, if the file could not be opened or is not valid JSON</returns>
+	bool ReadFrames(const FrameCallback& onFrame);
+
+	const std::string& GetError() const;
+
+private:
+	std::string m_filePath;
+	std::string m_error;
+};
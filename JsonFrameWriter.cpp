@@ -0,0 +1,94 @@
+#include "JsonFrameWriter.h"
+#include <charconv>
+
+namespace
+{
+	constexpr std::size_t FlushSize = 1 << 20;
+
+	void AppendNumber(std::string& buffer, uint64_t value)
+	{
+		char digits[20];
+		auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+		buffer.append(digits, end);
+	}
+}
+
+JsonFrameWriter::JsonFrameWriter(const std::string& filePath)
+	: m_file(filePath, std::ios::binary | std::ios::trunc)
+{
+	if (!m_file.is_open())
+		return;
+
+	// The EtherCAT ethertype as the recorded logs store it
+	m_buffer = "{\n    \"global\":\n    {\n        \"ethertype\": 42120\n    },\n    \"frames\":\n    [";
+	m_buffer.reserve(FlushSize + 4096);
+}
+
+JsonFrameWriter::~JsonFrameWriter()
+{
+	Close();
+}
+
+bool JsonFrameWriter::IsOpen() const
+{
+	return m_file.is_open();
+}
+
+bool JsonFrameWriter::WriteFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes)
+{
+	if (!m_file.is_open())
+	{
+		m_error = "The JSON log is not open";
+		return false;
+	}
+
+	m_buffer += m_frameCount == 0 ? "\n        { \"timestamp\": " : ",\n        { \"timestamp\": ";
+	AppendNumber(m_buffer, timestamp);
+	m_buffer += isInput ? ", \"input/output\": true, \"data\": [" : ", \"input/output\": false, \"data\": [";
+
+	for (std::size_t i = 0; i < changes.size(); ++i)
+	{
+		auto& change = changes[i];
+		m_buffer += i == 0 ? " { \"participant\": " : ", { \"participant\": ";
+		AppendNumber(m_buffer, change.participantId);
+		m_buffer += ", \"byte\": [";
+
+		for (unsigned int byte = 0; byte < change.byteCount; ++byte)
+		{
+			if (byte != 0)
+				m_buffer += ", ";
+			AppendNumber(m_buffer, change.bytes[byte]);
+		}
+
+		m_buffer += "] }";
+	}
+
+	m_buffer += " ] }";
+	++m_frameCount;
+
+	if (m_buffer.size() >= FlushSize)
+		Flush();
+
+	return true;
+}
+
+void JsonFrameWriter::Close()
+{
+	if (!m_file.is_open())
+		return;
+
+	m_buffer += "\n    ]\n}\n";
+	Flush();
+	m_file.close();
+}
+
+const std::string& JsonFrameWriter::GetError() const
+{
+	return m_error;
+}
+
+void JsonFrameWriter::Flush()
+{
+	m_file.write(m_buffer.data(), m_buffer.size());
+	m_buffer.clear();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+
+/// <summary>
+/// Writes frames into a JSON event log, in the schema read by JsonFrameReader.
+/// The frames are streamed with one frame per line, so the size of the log is not bound by the memory.
+/// </summary>
+class JsonFrameWriter
+{
+public:
+	explicit JsonFrameWriter(const std::string& filePath);
+	~JsonFrameWriter();
+
+	JsonFrameWriter(const JsonFrameWriter& other) = delete;
+	void operator=(const JsonFrameWriter&) = delete;
+
+public:
+	bool IsOpen() const;
+
+	/// <returns>false, if the log is not open</returns>
+	bool WriteFrame(const uint64_t& timestamp, bool isInput, std::span<const Change> changes);
+
+	/// <summary>
+	/// Closes the frame array and the document
+	/// </summary>
+	void Close();
+
+	const std::string& GetError() const;
+
+private:
+	void Flush();
+
+private:
+	std::ofstream m_file;
+	std::string m_error;
+	// Frames are formatted into the buffer and written in large blocks
+	std::string m_buffer;
+	uint64_t m_frameCount = 0;
+};
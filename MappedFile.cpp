@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+	auto file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		return;
+
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+		return;
+
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data)
+		m_size = static_cast<std::size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filePath)
+{
+	m_file = open(filePath.c_str(), O_RDONLY);
+	if (m_file < 0)
+		return;
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0 || info.st_size == 0)
+		return;
+
+	auto data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+		return;
+
+	// Every reader walks its frames front to back, a chunked read its own chunk on every pass, so the kernel reads ahead.
+	// Under memory pressure the pages read are reclaimed first, the second pass of a chunked read may fault them in again.
+	madvise(data, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+
+	m_data = static_cast<const unsigned char*>(data);
+	m_size = static_cast<std::size_t>(info.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	if (m_file >= 0)
+		close(m_file);
+}
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return m_data != nullptr;
+}
+
+const unsigned char* MappedFile::GetData() const
+{
+	return m_data;
+}
+
+std::size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+/// <summary>
+/// Read-only memory mapping of a whole file
+/// </summary>
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& filePath);
+	~MappedFile();
+
+	MappedFile(const MappedFile& other) = delete;
+	void operator=(const MappedFile&) = delete;
+
+public:
+	bool IsOpen() const;
+
+	const unsigned char* GetData() const;
+
+	std::size_t GetSize() const;
+
+private:
+	const unsigned char* m_data = nullptr;
+	std::size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+};
@@ -1,60 +1,15 @@
 #include "Participant.h"
 #include <string.h>
-#include <vector>
 
-Participant::Participant(const unsigned short id, unsigned char* bytes, unsigned int count, bool isInput)
+Participant::Participant(const unsigned short id, const unsigned char* bytes, unsigned int count, bool isInput)
 	: m_id(id)
-	, m_byteCount(count)
 	, m_bytes(bytes)
+	, m_byteCount(count)
 	, m_isInput(isInput)
 {
 }
 
-Participant::Participant(const Participant& other)
-	: m_id(other.m_id)
-	, m_byteCount(other.m_byteCount)
-	, m_isInput(other.m_isInput)
-{
-	if (m_byteCount > 0)
-	{
-		m_bytes = new unsigned char[m_byteCount];
-		memcpy(m_bytes, other.m_bytes, m_byteCount);
-	}
-	else
-		m_bytes = nullptr;
-}
-
-Participant::~Participant()
-{
-	delete[] m_bytes;
-}
-
-void Participant::operator=(const Participant& other)
-{
-	if (m_id != other.m_id || m_byteCount != other.m_byteCount)
-		return;
-
-	if (m_byteCount > 0)
-	{
-		delete[] m_bytes;
-		m_bytes = new unsigned char[m_byteCount];
-		memcpy(m_bytes, other.m_bytes, m_byteCount);
-	}
-}
-
-void Participant::ChangeBytes(unsigned char* bytes)
-{
-	if (!m_bytes)
-	{
-		delete[] bytes;
-		return;
-	}
-	
-	delete[] m_bytes;
-	m_bytes = bytes;
-}
-
-int Participant::Cmp(unsigned char* bytes) const
+int Participant::Cmp(const unsigned char* bytes) const
 {
 	if (!m_bytes || m_byteCount == 0)
 		return 1;
@@ -95,3 +50,18 @@ std::string Participant::Print() const
 
 	return outString + " )";
 }
+
+unsigned short Participant::GetId() const
+{
+	return m_id;
+}
+
+const unsigned char* Participant::GetBytes() const
+{
+	return m_bytes;
+}
+
+unsigned int Participant::GetByteCount() const
+{
+	return m_byteCount;
+}
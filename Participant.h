@@ -1,18 +1,17 @@
 #pragma once
 #include <string>
 
+/// <summary>
+/// View of the bytes of one participant inside a process image.
+/// The bytes are owned by the image.
+/// </summary>
 class Participant
 {
 public:
-	explicit Participant(const unsigned short id, unsigned char* bytes, unsigned int count, bool isInput);
-	Participant(const Participant& other);
-	~Participant();
-	void operator=(const Participant& other);
+	explicit Participant(const unsigned short id, const unsigned char* bytes, unsigned int count, bool isInput);
 
 public:
-	void ChangeBytes(unsigned char* bytes);
-
-	int Cmp(unsigned char* bytes) const;
+	int Cmp(const unsigned char* bytes) const;
 
 	int Cmp(const Participant& other) const;
 
@@ -20,8 +19,14 @@ public:
 
 	std::string Print() const;
 
+	unsigned short GetId() const;
+
+	const unsigned char* GetBytes() const;
+
+	unsigned int GetByteCount() const;
+
 public:
-	bool operator==(const Participant& other)
+	bool operator==(const Participant& other) const
 	{
 		if (m_id != other.m_id
 			|| m_byteCount != other.m_byteCount)
@@ -33,7 +38,7 @@ public:
 
 		return true;
 	}
-	bool operator!=(const Participant& other)
+	bool operator!=(const Participant& other) const
 	{
 		return !(*this == other);
 	}
@@ -50,7 +55,7 @@ public:
 
 private:
 	const unsigned short m_id;
-	unsigned char* m_bytes;
+	const unsigned char* m_bytes;
 	const unsigned int m_byteCount;
 	const bool m_isInput;
 };
@@ -0,0 +1,607 @@
+#include "PcapFrameReader.h"
+#include "ImageKernels.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+
+namespace
+{
+	constexpr uint32_t PcapMagicMicroseconds = 0xA1B2C3D4;
+	constexpr uint32_t PcapMagicNanoseconds = 0xA1B23C4D;
+	constexpr uint32_t PcapNgSectionHeader = 0x0A0D0D0A;
+	constexpr uint32_t PcapNgByteOrderMagic = 0x1A2B3C4D;
+	constexpr uint32_t PcapNgInterfaceDescription = 0x00000001;
+	constexpr uint32_t PcapNgPacket = 0x00000002;
+	constexpr uint32_t PcapNgEnhancedPacket = 0x00000006;
+	constexpr uint16_t PcapNgTimestampResolution = 9;
+	constexpr uint32_t LinkTypeEthernet = 1;
+
+	constexpr uint16_t EthertypeVlan = 0x8100;
+	constexpr std::size_t EthernetHeaderSize = 14;
+	constexpr std::size_t VlanTagSize = 4;
+	constexpr std::size_t EtherCatHeaderSize = 2;
+	constexpr std::size_t DatagramHeaderSize = 10;
+	constexpr std::size_t WorkingCounterSize = 2;
+	constexpr uint16_t EtherCatTypeDatagrams = 1;
+
+	constexpr uint16_t StationAddressRegister = 0x0010;
+	constexpr uint16_t FmmuRegister = 0x0600;
+	constexpr unsigned int FmmuSize = 16;
+	constexpr unsigned int FmmuCount = 16;
+	constexpr uint8_t FmmuTypeRead = 1;
+	constexpr uint8_t FmmuTypeWrite = 2;
+
+	enum class Direction
+	{
+		None,
+		Input,
+		Output,
+		Both
+	};
+
+	enum class Addressing
+	{
+		None,
+		Position,
+		Station,
+		Broadcast,
+		Logical
+	};
+
+	/// <summary>
+	/// Process data direction of the EtherCAT commands
+	/// </summary>
+	Direction GetDirection(uint8_t command)
+	{
+		if (command == 0 || command > 12)
+			return Direction::None;
+
+		// Every addressing has a read, a write and a read write command in this order
+		switch ((command - 1) % 3)
+		{
+		case 0:
+			return Direction::Input;
+		case 1:
+			return Direction::Output;
+		default:
+			return Direction::Both;
+		}
+	}
+
+	/// <summary>
+	/// APxx, FPxx, Bxx and Lxx commands
+	/// </summary>
+	Addressing GetAddressing(uint8_t command)
+	{
+		if (command == 0 || command > 12)
+			return Addressing::None;
+
+		constexpr Addressing Addressings[] = { Addressing::Position, Addressing::Station, Addressing::Broadcast, Addressing::Logical };
+		return Addressings[(command - 1) / 3];
+	}
+
+	uint16_t Read16(const unsigned char* data, bool swapped)
+	{
+		uint16_t value;
+		memcpy(&value, data, sizeof(value));
+		return swapped ? static_cast<uint16_t>((value >> 8) | (value << 8)) : value;
+	}
+
+	uint32_t Read32(const unsigned char* data, bool swapped)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		if (!swapped)
+			return value;
+		return (value >> 24) | ((value >> 8) & 0x0000FF00) | ((value << 8) & 0x00FF0000) | (value << 24);
+	}
+
+	uint16_t ReadBigEndian16(const unsigned char* data)
+	{
+		return static_cast<uint16_t>((data[0] << 8) | data[1]);
+	}
+
+	uint16_t ReadLittleEndian16(const unsigned char* data)
+	{
+		return static_cast<uint16_t>(data[0] | (data[1] << 8));
+	}
+
+	uint32_t ReadLittleEndian32(const unsigned char* data)
+	{
+		return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+			| (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+	}
+
+	/// <summary>
+	/// Converts the timestamp of a pcapng interface into microseconds.
+	/// Binary resolutions are below 2^-64, the reader rejects the others.
+	/// </summary>
+	uint64_t ToMicroseconds(const uint64_t& timestamp, uint8_t resolution)
+	{
+		if (resolution & 0x80)
+			return static_cast<uint64_t>(static_cast<long double>(timestamp) * 1e6L
+				/ static_cast<long double>(1ULL << (resolution & 0x7F)));
+
+		uint64_t value = timestamp;
+		for (uint8_t i = resolution; i > 6; --i)
+			value /= 10;
+		for (uint8_t i = resolution; i < 6; ++i)
+			value *= 10;
+		return value;
+	}
+}
+
+PcapFrameReader::PcapFrameReader(const std::string& filePath, uint16_t ethertype /*= EtherCatEthertype*/)
+	: m_file(filePath)
+	, m_filePath(filePath)
+	, m_ethertype(ethertype)
+{
+}
+
+bool PcapFrameReader::IsCapture(const std::string& filePath)
+{
+	std::ifstream f(filePath, std::ios::binary);
+	unsigned char magic[4] = {};
+	f.read(reinterpret_cast<char*>(magic), sizeof(magic));
+	if (f.gcount() != sizeof(magic))
+		return false;
+
+	auto value = Read32(magic, false);
+	auto swapped = Read32(magic, true);
+	return value == PcapNgSectionHeader
+		|| value == PcapMagicMicroseconds || swapped == PcapMagicMicroseconds
+		|| value == PcapMagicNanoseconds || swapped == PcapMagicNanoseconds;
+}
+
+bool PcapFrameReader::ReadFrames(const FrameCallback& onFrame)
+{
+	if (!m_file.IsOpen() || m_file.GetSize() < 4)
+	{
+		m_error = "Could not map " + m_filePath;
+		return false;
+	}
+
+	m_hasFirstTimestamp = false;
+	m_stationParticipants.clear();
+	m_logicalRanges.clear();
+	m_logicalImages.clear();
+	m_changedImages.clear();
+	m_logicalParticipants.clear();
+	m_sentPositions.fill(UINT32_MAX);
+	m_lastInput.assign(UINT16_MAX + 1, {});
+	m_lastOutput.assign(UINT16_MAX + 1, {});
+
+	if (Read32(m_file.GetData(), false) == PcapNgSectionHeader)
+		return ReadPcapNg(onFrame);
+
+	return ReadPcap(onFrame);
+}
+
+const std::string& PcapFrameReader::GetError() const
+{
+	return m_error;
+}
+
+bool PcapFrameReader::ReadPcap(const FrameCallback& onFrame)
+{
+	constexpr std::size_t GlobalHeaderSize = 24;
+	constexpr std::size_t RecordHeaderSize = 16;
+
+	const unsigned char* data = m_file.GetData();
+	const std::size_t size = m_file.GetSize();
+
+	if (size < GlobalHeaderSize)
+	{
+		m_error = m_filePath + " is too small for a pcap file";
+		return false;
+	}
+
+	bool swapped = Read32(data, false) != PcapMagicMicroseconds && Read32(data, false) != PcapMagicNanoseconds;
+	bool nanoseconds = Read32(data, swapped) == PcapMagicNanoseconds;
+
+	if (Read32(data + 20, swapped) != LinkTypeEthernet)
+	{
+		m_error = m_filePath + " is no Ethernet capture";
+		return false;
+	}
+
+	std::size_t offset = GlobalHeaderSize;
+	while (offset + RecordHeaderSize <= size)
+	{
+		uint64_t seconds = Read32(data + offset, swapped);
+		uint64_t fraction = Read32(data + offset + 4, swapped);
+		uint32_t capturedLength = Read32(data + offset + 8, swapped);
+		offset += RecordHeaderSize;
+
+		if (offset + capturedLength > size)
+		{
+			m_error = m_filePath + " is truncated";
+			return false;
+		}
+
+		uint64_t timestamp = seconds * 1000000 + (nanoseconds ? fraction / 1000 : fraction);
+		ProcessPacket(timestamp, data + offset, capturedLength, onFrame);
+		offset += capturedLength;
+	}
+
+	return true;
+}
+
+bool PcapFrameReader::ReadPcapNg(const FrameCallback& onFrame)
+{
+	constexpr std::size_t BlockHeaderSize = 8;
+
+	const unsigned char* data = m_file.GetData();
+	const std::size_t size = m_file.GetSize();
+
+	bool swapped = false;
+	std::vector<uint8_t> interfaceResolutions;
+	std::vector<bool> interfaceIsEthernet;
+
+	std::size_t offset = 0;
+	while (offset + BlockHeaderSize <= size)
+	{
+		auto blockType = Read32(data + offset, false);
+
+		// The byte order is defined by every section header
+		if (blockType == PcapNgSectionHeader)
+		{
+			if (offset + 12 > size)
+				break;
+			swapped = Read32(data + offset + 8, false) != PcapNgByteOrderMagic;
+			interfaceResolutions.clear();
+			interfaceIsEthernet.clear();
+		}
+		else
+			blockType = Read32(data + offset, swapped);
+
+		auto blockLength = Read32(data + offset + 4, swapped);
+		if (blockLength < BlockHeaderSize + 4 || offset + blockLength > size)
+		{
+			m_error = m_filePath + " is truncated";
+			return false;
+		}
+
+		const unsigned char* body = data + offset + BlockHeaderSize;
+		const std::size_t bodyLength = blockLength - BlockHeaderSize - 4;
+
+		switch (blockType)
+		{
+		case PcapNgInterfaceDescription:
+		{
+			if (bodyLength < 8)
+				break;
+
+			uint8_t resolution = 6;
+			std::size_t option = 8;
+			while (option + 4 <= bodyLength)
+			{
+				auto code = Read16(body + option, swapped);
+				auto length = Read16(body + option + 2, swapped);
+				if (code == 0 || option + 4 + length > bodyLength)
+					break;
+				if (code == PcapNgTimestampResolution && length >= 1)
+					resolution = body[option + 4];
+				option += 4 + ((length + 3) & ~3);
+			}
+
+			// A binary resolution is a power of 2, which has to fit the 64 bits of the divisor
+			if ((resolution & 0x80) && (resolution & 0x7F) >= 64)
+			{
+				m_error = m_filePath + " has an unsupported timestamp resolution";
+				return false;
+			}
+
+			interfaceIsEthernet.push_back(Read16(body, swapped) == LinkTypeEthernet);
+			interfaceResolutions.push_back(resolution);
+			break;
+		}
+		case PcapNgEnhancedPacket:
+		case PcapNgPacket:
+		{
+			if (bodyLength < 20)
+				break;
+
+			uint32_t interfaceId = blockType == PcapNgPacket
+				? Read16(body, swapped)
+				: Read32(body, swapped);
+			if (interfaceId >= interfaceIsEthernet.size() || !interfaceIsEthernet[interfaceId])
+				break;
+
+			uint64_t timestamp = (static_cast<uint64_t>(Read32(body + 4, swapped)) << 32) | Read32(body + 8, swapped);
+			uint32_t capturedLength = Read32(body + 12, swapped);
+			if (20 + static_cast<std::size_t>(capturedLength) > bodyLength)
+				break;
+
+			ProcessPacket(ToMicroseconds(timestamp, interfaceResolutions[interfaceId]), body + 20, capturedLength, onFrame);
+			break;
+		}
+		default:
+			break;
+		}
+
+		offset += blockLength;
+	}
+
+	return true;
+}
+
+void PcapFrameReader::ProcessPacket(const uint64_t& timestamp, const unsigned char* packet, std::size_t length, const FrameCallback& onFrame)
+{
+	if (length < EthernetHeaderSize)
+		return;
+
+	std::size_t offset = 12;
+	auto ethertype = ReadBigEndian16(packet + offset);
+	while (ethertype == EthertypeVlan && offset + VlanTagSize + 2 <= length)
+	{
+		offset += VlanTagSize;
+		ethertype = ReadBigEndian16(packet + offset);
+	}
+	offset += 2;
+
+	if (ethertype != m_ethertype || offset + EtherCatHeaderSize > length)
+		return;
+
+	auto etherCatHeader = ReadLittleEndian16(packet + offset);
+	offset += EtherCatHeaderSize;
+
+	if ((etherCatHeader >> 12) != EtherCatTypeDatagrams)
+		return;
+
+	// The EtherCAT length excludes the ethernet padding
+	const std::size_t end = std::min(length, offset + (etherCatHeader & 0x07FF));
+
+	m_inputChanges.clear();
+	m_outputChanges.clear();
+
+	bool moreDatagrams = true;
+	while (moreDatagrams && offset + DatagramHeaderSize <= end)
+	{
+		const unsigned char* datagram = packet + offset;
+		auto command = datagram[0];
+		auto index = datagram[1];
+		auto position = ReadLittleEndian16(datagram + 2);
+		auto registerOffset = ReadLittleEndian16(datagram + 4);
+		auto lengthField = ReadLittleEndian16(datagram + 6);
+		unsigned int byteCount = lengthField & 0x07FF;
+		moreDatagrams = (lengthField & 0x8000) != 0;
+
+		offset += DatagramHeaderSize;
+		if (offset + byteCount + WorkingCounterSize > end)
+			break;
+
+		const unsigned char* bytes = packet + offset;
+		auto workingCounter = ReadLittleEndian16(bytes + byteCount);
+		offset += byteCount + WorkingCounterSize;
+
+		ProcessDatagram(command, index, position, registerOffset, bytes, byteCount, workingCounter);
+	}
+
+	AddLogicalImages();
+
+	if (m_outputChanges.empty() && m_inputChanges.empty())
+		return;
+
+	if (!m_hasFirstTimestamp)
+	{
+		m_firstTimestamp = timestamp;
+		m_hasFirstTimestamp = true;
+	}
+
+	auto relativeTime = timestamp >= m_firstTimestamp ? timestamp - m_firstTimestamp : 0;
+
+	if (!m_outputChanges.empty())
+		onFrame(relativeTime, false, m_outputChanges);
+	if (!m_inputChanges.empty())
+		onFrame(relativeTime, true, m_inputChanges);
+}
+
+void PcapFrameReader::ProcessDatagram(uint8_t command, uint8_t index, uint16_t position, uint16_t offset, const unsigned char* bytes, unsigned int byteCount, uint16_t workingCounter)
+{
+	auto direction = GetDirection(command);
+	unsigned short participantId;
+
+	switch (GetAddressing(command))
+	{
+	case Addressing::Position:
+	{
+		// Every slave increments the address of a passing frame, so only frames on their way out hold
+		// the negated position, which is the participant id. Returning frames are matched by the index.
+		auto& sentPosition = m_sentPositions[index];
+		if (workingCounter == 0)
+			sentPosition = position;
+		else if (sentPosition > UINT16_MAX)
+			return;
+		participantId = static_cast<unsigned short>(sentPosition);
+		break;
+	}
+	case Addressing::Station:
+	{
+		auto participant = m_stationParticipants.find(position);
+		if (participant == m_stationParticipants.end())
+			return;
+		participantId = participant->second;
+		break;
+	}
+	case Addressing::Logical:
+		AddLogicalChanges(command, static_cast<uint32_t>(position) | (static_cast<uint32_t>(offset) << 16), bytes, byteCount, workingCounter);
+		return;
+	default:
+		// Broadcasts address every participant at once
+		return;
+	}
+
+	if (direction != Direction::Input && Configure(participantId, offset, bytes, byteCount))
+		return;
+
+	// The process data of a participant with FMMUs is exchanged logically, its addressed datagrams access registers
+	bool isInput = direction == Direction::Input || (direction == Direction::Both && workingCounter > 0);
+	for (auto& range : m_logicalRanges)
+		if (range.participantId == participantId && range.isInput == isInput)
+			return;
+
+	// Inputs are only valid after a slave processed the datagram
+	if (direction != Direction::Input || workingCounter > 0)
+		AddChange(isInput, participantId, bytes, byteCount);
+}
+
+bool PcapFrameReader::Configure(unsigned short participantId, uint16_t offset, const unsigned char* bytes, unsigned int byteCount)
+{
+	if (offset == StationAddressRegister && byteCount >= 2)
+	{
+		m_stationParticipants[ReadLittleEndian16(bytes)] = participantId;
+		return true;
+	}
+
+	if (offset < FmmuRegister || offset >= FmmuRegister + FmmuSize * FmmuCount || (offset - FmmuRegister) % FmmuSize != 0)
+		return false;
+
+	bool isRearranged = false;
+	for (unsigned int i = 0; (i + 1) * FmmuSize <= byteCount; ++i)
+	{
+		auto fmmu = static_cast<uint8_t>((offset - FmmuRegister) / FmmuSize + i);
+		if (fmmu >= FmmuCount)
+			break;
+
+		const unsigned char* entry = bytes + i * FmmuSize;
+
+		// A rewritten FMMU replaces its range
+		isRearranged |= std::erase_if(m_logicalRanges, [participantId, fmmu](const LogicalRange& range)
+			{
+				return range.participantId == participantId && range.fmmu == fmmu;
+			}) != 0;
+
+		auto type = entry[11];
+		bool isActive = (entry[12] & 1) != 0;
+		auto length = ReadLittleEndian16(entry + 4);
+		if (!isActive || length == 0 || (type != FmmuTypeRead && type != FmmuTypeWrite))
+			continue;
+
+		m_logicalRanges.push_back({ ReadLittleEndian32(entry), length, participantId, fmmu, type == FmmuTypeRead });
+		isRearranged = true;
+	}
+
+	if (isRearranged)
+		ArrangeLogicalImages();
+
+	return true;
+}
+
+void PcapFrameReader::ArrangeLogicalImages()
+{
+	std::sort(m_logicalRanges.begin(), m_logicalRanges.end(), [](const LogicalRange& a, const LogicalRange& b)
+		{
+			return std::tie(a.participantId, a.isInput, a.fmmu) < std::tie(b.participantId, b.isInput, b.fmmu);
+		});
+
+	// The ranges of one participant and direction follow each other, every image starts over and is reported again
+	m_logicalImages.clear();
+	m_changedImages.clear();
+	for (auto& range : m_logicalRanges)
+	{
+		if (m_logicalImages.empty()
+			|| m_logicalImages.back().participantId != range.participantId
+			|| m_logicalImages.back().isInput != range.isInput)
+			m_logicalImages.push_back({ range.participantId, range.isInput });
+
+		auto& image = m_logicalImages.back();
+		range.image = static_cast<uint32_t>(m_logicalImages.size() - 1);
+		range.imageOffset = static_cast<uint32_t>(image.bytes.size());
+		image.bytes.resize(image.bytes.size() + range.byteCount, 0);
+	}
+}
+
+void PcapFrameReader::AddLogicalChanges(uint8_t command, uint32_t address, const unsigned char* bytes, unsigned int byteCount, uint16_t workingCounter)
+{
+	auto direction = GetDirection(command);
+
+	if (m_logicalRanges.empty())
+	{
+		// Without FMMUs the logical address identifies the process data
+		auto [participant, isNew] = m_logicalParticipants.try_emplace(address, static_cast<unsigned short>(m_logicalParticipants.size() + 1));
+		if (isNew && m_logicalParticipants.size() > UINT16_MAX)
+		{
+			m_logicalParticipants.erase(participant);
+			return;
+		}
+
+		if (direction == Direction::Output || (direction == Direction::Both && workingCounter == 0))
+			AddChange(false, participant->second, bytes, byteCount);
+		else if (workingCounter > 0)
+			AddChange(true, participant->second, bytes, byteCount);
+		return;
+	}
+
+	// Every range writes its part of the datagram into the image of its participant
+	for (auto& range : m_logicalRanges)
+	{
+		if (range.isInput ? direction == Direction::Output : direction == Direction::Input)
+			continue;
+		if (range.isInput && workingCounter == 0)
+			continue;
+
+		uint64_t start = std::max<uint64_t>(range.start, address);
+		uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(range.start) + range.byteCount, static_cast<uint64_t>(address) + byteCount);
+		if (start >= end)
+			continue;
+
+		auto& image = m_logicalImages[range.image];
+		auto imageBytes = image.bytes.data() + range.imageOffset + (start - range.start);
+		auto sliceBytes = bytes + (start - address);
+		auto sliceCount = static_cast<std::size_t>(end - start);
+		if (image.isReported && ImageKernels::Equal(imageBytes, sliceBytes, sliceCount))
+			continue;
+
+		std::memcpy(imageBytes, sliceBytes, sliceCount);
+		if (!image.isChanged)
+		{
+			image.isChanged = true;
+			m_changedImages.push_back(range.image);
+		}
+	}
+}
+
+void PcapFrameReader::AddLogicalImages()
+{
+	for (auto index : m_changedImages)
+	{
+		auto& image = m_logicalImages[index];
+		image.isReported = true;
+		image.isChanged = false;
+
+		// The image stays in place until the next packet, like the bytes in the mapping
+		(image.isInput ? m_inputChanges : m_outputChanges).push_back({ image.participantId, static_cast<unsigned int>(image.bytes.size()), image.bytes.data() });
+	}
+
+	m_changedImages.clear();
+}
+
+void PcapFrameReader::AddChange(bool isInput, unsigned short participantId, const unsigned char* bytes, unsigned int byteCount)
+{
+	auto& last = (isInput ? m_lastInput : m_lastOutput)[participantId];
+
+	if (last.bytes
+		&& last.byteCount == byteCount
+		&& ImageKernels::Equal(last.bytes, bytes, byteCount))
+		return;
+
+	last.bytes = bytes;
+	last.byteCount = byteCount;
+
+	auto& changes = isInput ? m_inputChanges : m_outputChanges;
+
+	// A participant addressed twice in one packet keeps the latest values
+	for (auto& change : changes)
+	{
+		if (change.participantId != participantId)
+			continue;
+
+		change.byteCount = byteCount;
+		change.bytes = bytes;
+		return;
+	}
+
+	changes.push_back({ participantId, byteCount, bytes });
+}
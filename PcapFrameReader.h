@@ -0,0 +1,134 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include "MappedFile.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Reads EtherCAT bus captures in the pcap or pcapng format directly from a memory mapping.
+/// Datagrams are mapped to participants by their addressing: auto increment datagrams by the position
+/// of the slave, configured address datagrams by the station addresses the capture assigned and
+/// logical datagrams by the FMMU ranges the capture configured. Without FMMUs every logical address
+/// is a participant of its own, with ids counting up from 1. Broadcasts and datagrams that cannot be
+/// mapped are dropped. Read commands are inputs, write commands outputs. A participant with FMMUs reports
+/// the image of all of its ranges of one direction in the order of the FMMUs, any other participant the bytes
+/// of its last datagram. Only participants whose bytes changed are reported.
+/// The timestamps are microseconds since the first EtherCAT packet.
+/// </summary>
+class PcapFrameReader
+{
+public:
+	static constexpr uint16_t EtherCatEthertype = 0x88A4;
+
+	explicit PcapFrameReader(const std::string& filePath, uint16_t ethertype = EtherCatEthertype);
+
+	/// <summary>
+	/// Checks the magic number of the file for pcap or pcapng
+	/// </summary>
+	static bool IsCapture(const std::string& filePath);
+
+	/// <summary>
+	/// Calls onFrame for every packet with changed process data
+	/// </summary>
+	/// <returns>false, if the file could not be mapped or is no supported capture</returns>
+	bool ReadFrames(const FrameCallback& onFrame);
+
+	const std::string& GetError() const;
+
+private:
+	struct LastValues
+	{
+		const unsigned char* bytes = nullptr;
+		unsigned int byteCount = 0;
+	};
+
+	/// <summary>
+	/// Logical process data of a participant, configured by one of its FMMUs
+	/// </summary>
+	struct LogicalRange
+	{
+		uint32_t start;
+		uint32_t byteCount;
+		unsigned short participantId;
+		uint8_t fmmu;
+		bool isInput;
+		// The image of the participant in this direction and the position of the range in it
+		uint32_t image;
+		uint32_t imageOffset;
+	};
+
+	/// <summary>
+	/// The logical process data of a participant in one direction, assembled from all of its FMMU ranges
+	/// </summary>
+	struct LogicalImage
+	{
+		unsigned short participantId;
+		bool isInput;
+		std::vector<unsigned char> bytes;
+		bool isReported = false;
+		bool isChanged = false;
+	};
+
+	bool ReadPcap(const FrameCallback& onFrame);
+	bool ReadPcapNg(const FrameCallback& onFrame);
+
+	/// <summary>
+	/// Decodes one captured link layer packet and reports its changes
+	/// </summary>
+	void ProcessPacket(const uint64_t& timestamp, const unsigned char* packet, std::size_t length, const FrameCallback& onFrame);
+
+	/// <summary>
+	/// Maps one datagram to its participants and reports its changes
+	/// </summary>
+	void ProcessDatagram(uint8_t command, uint8_t index, uint16_t position, uint16_t offset, const unsigned char* bytes, unsigned int byteCount, uint16_t workingCounter);
+
+	/// <summary>
+	/// Learns the station address and the FMMUs written to a participant
+	/// </summary>
+	/// <returns>true, if the datagram configured the participant and holds no process data</returns>
+	bool Configure(unsigned short participantId, uint16_t offset, const unsigned char* bytes, unsigned int byteCount);
+
+	/// <summary>
+	/// Lays out the images of the participants after their FMMUs changed
+	/// </summary>
+	void ArrangeLogicalImages();
+
+	void AddLogicalChanges(uint8_t command, uint32_t address, const unsigned char* bytes, unsigned int byteCount, uint16_t workingCounter);
+
+	/// <summary>
+	/// Reports the images the datagrams of the packet changed
+	/// </summary>
+	void AddLogicalImages();
+
+	void AddChange(bool isInput, unsigned short participantId, const unsigned char* bytes, unsigned int byteCount);
+
+private:
+	MappedFile m_file;
+	std::string m_filePath;
+	std::string m_error;
+	uint16_t m_ethertype;
+
+	bool m_hasFirstTimestamp = false;
+	uint64_t m_firstTimestamp = 0;
+
+	// The auto increment address of the last datagram sent with every index
+	std::array<uint32_t, 256> m_sentPositions;
+	// The participant id of every configured station address
+	std::unordered_map<uint16_t, unsigned short> m_stationParticipants;
+	std::vector<LogicalRange> m_logicalRanges;
+	std::vector<LogicalImage> m_logicalImages;
+	std::vector<uint32_t> m_changedImages;
+	// The participant id of every logical address, while no FMMU is configured
+	std::unordered_map<uint32_t, unsigned short> m_logicalParticipants;
+
+	// The last values point into the mapping, indexed by participant id
+	std::vector<LastValues> m_lastInput;
+	std::vector<LastValues> m_lastOutput;
+
+	// Reused for every packet
+	std::vector<Change> m_inputChanges;
+	std::vector<Change> m_outputChanges;
+};
@@ -0,0 +1,100 @@
+#include "ProcessImageTable.h"
+#include "ImageKernels.h"
+
+namespace
+{
+	constexpr std::size_t InitialSlotCount = 64;
+}
+
+ProcessImageTable::ProcessImageTable(std::size_t imageSize /*= 0*/)
+	: m_imageSize(imageSize)
+{
+}
+
+void ProcessImageTable::SetImageSize(std::size_t imageSize)
+{
+	m_imageSize = imageSize;
+	m_images.clear();
+	m_hashes.clear();
+	m_slots.clear();
+}
+
+std::pair<uint32_t, bool> ProcessImageTable::Intern(const unsigned char* image, uint64_t hash)
+{
+	// Keep the load factor below one half
+	if ((m_hashes.size() + 1) * 2 > m_slots.size())
+		Grow();
+
+	const std::size_t mask = m_slots.size() - 1;
+	std::size_t slot = static_cast<std::size_t>(hash) & mask;
+
+	while (m_slots[slot] != 0)
+	{
+		uint32_t id = m_slots[slot] - 1;
+		if (m_hashes[id] == hash
+			&& (m_imageSize == 0 || ImageKernels::Equal(GetImage(id), image, m_imageSize)))
+			return { id, false };
+
+		slot = (slot + 1) & mask;
+	}
+
+	uint32_t id = static_cast<uint32_t>(m_hashes.size());
+	m_slots[slot] = id + 1;
+	m_hashes.push_back(hash);
+	m_images.insert(m_images.end(), image, image + m_imageSize);
+
+	return { id, true };
+}
+
+std::pair<uint32_t, bool> ProcessImageTable::Intern(const unsigned char* image)
+{
+	return Intern(image, Hash(image, m_imageSize));
+}
+
+const unsigned char* ProcessImageTable::GetImage(uint32_t id) const
+{
+	return m_images.data() + static_cast<std::size_t>(id) * m_imageSize;
+}
+
+uint64_t ProcessImageTable::GetHash(uint32_t id) const
+{
+	return m_hashes[id];
+}
+
+std::size_t ProcessImageTable::GetImageSize() const
+{
+	return m_imageSize;
+}
+
+std::size_t ProcessImageTable::GetImageCount() const
+{
+	return m_hashes.size();
+}
+
+std::size_t ProcessImageTable::GetByteCount() const
+{
+	return m_images.capacity()
+		+ m_hashes.capacity() * sizeof(uint64_t)
+		+ m_slots.capacity() * sizeof(uint32_t);
+}
+
+uint64_t ProcessImageTable::Hash(const unsigned char* data, std::size_t size, uint64_t seed /*= 0*/)
+{
+	return ImageKernels::Hash(data, size, seed);
+}
+
+void ProcessImageTable::Grow()
+{
+	std::vector<uint32_t> slots(m_slots.empty() ? InitialSlotCount : m_slots.size() * 2, 0);
+	const std::size_t mask = slots.size() - 1;
+
+	for (uint32_t id = 0; id < m_hashes.size(); ++id)
+	{
+		std::size_t slot = static_cast<std::size_t>(m_hashes[id]) & mask;
+		while (slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		slots[slot] = id + 1;
+	}
+
+	m_slots.swap(slots);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Hash table interning process images of a fixed size into dense ids.
+/// All unique images are stored back to back in one buffer.
+/// </summary>
+class ProcessImageTable
+{
+public:
+	explicit ProcessImageTable(std::size_t imageSize = 0);
+
+public:
+	/// <summary>
+	/// Sets the size of the images, which clears the table
+	/// </summary>
+	void SetImageSize(std::size_t imageSize);
+
+	/// <summary>
+	/// Looks up the image and inserts it, if it is new
+	/// </summary>
+	/// <returns>The id of the image and if it was inserted</returns>
+	std::pair<uint32_t, bool> Intern(const unsigned char* image, uint64_t hash);
+
+	std::pair<uint32_t, bool> Intern(const unsigned char* image);
+
+	const unsigned char* GetImage(uint32_t id) const;
+
+	/// <summary>
+	/// The hash the image was interned with
+	/// </summary>
+	uint64_t GetHash(uint32_t id) const;
+
+	std::size_t GetImageSize() const;
+
+	std::size_t GetImageCount() const;
+
+	/// <summary>
+	/// Memory of the images, their hashes and the slots
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+	static uint64_t Hash(const unsigned char* data, std::size_t size, uint64_t seed = 0);
+
+private:
+	void Grow();
+
+private:
+	std::size_t m_imageSize;
+	std::vector<unsigned char> m_images;
+	std::vector<uint64_t> m_hashes;
+	// Open addressing with linear probing, a slot holds id + 1 or 0 if empty
+	std::vector<uint32_t> m_slots;
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Bounded lock free ring buffer between exactly one producer and one consumer thread
+/// </summary>
+template<typename T>
+class SpscQueue
+{
+public:
+	/// <summary>
+	/// The capacity is rounded up to a power of two
+	/// </summary>
+	explicit SpscQueue(std::size_t capacity)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_items.resize(size);
+		m_mask = size - 1;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+public:
+	/// <summary>
+	/// Only called by the producer
+	/// </summary>
+	/// <returns>false, if the queue is full</returns>
+	bool TryPush(const T& item)
+	{
+		auto tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == m_items.size())
+			return false;
+
+		m_items[tail & m_mask] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// <summary>
+	/// Only called by the consumer
+	/// </summary>
+	/// <returns>false, if the queue is empty</returns>
+	bool TryPop(T& item)
+	{
+		auto head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false;
+
+		item = m_items[head & m_mask];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// <summary>
+	/// Waits for a free slot
+	/// </summary>
+	/// <returns>false, if the queue was closed</returns>
+	bool Push(const T& item)
+	{
+		while (!IsClosed())
+		{
+			if (TryPush(item))
+				return true;
+			std::this_thread::yield();
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// Waits for the next item
+	/// </summary>
+	/// <returns>false, once the queue is closed and empty</returns>
+	bool Pop(T& item)
+	{
+		while (!TryPop(item))
+		{
+			// Items pushed before the queue was closed are still delivered
+			if (IsClosed())
+				return TryPop(item);
+			std::this_thread::yield();
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Ends the stream, either side may close the queue
+	/// </summary>
+	void Close()
+	{
+		m_isClosed.store(true, std::memory_order_release);
+	}
+
+	bool IsClosed() const
+	{
+		return m_isClosed.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<T> m_items;
+	std::size_t m_mask = 0;
+	// Producer and consumer index on their own cache lines
+	alignas(64) std::atomic<std::size_t> m_head{ 0 };
+	alignas(64) std::atomic<std::size_t> m_tail{ 0 };
+	std::atomic<bool> m_isClosed{ false };
+};
@@ -0,0 +1,340 @@
+#include "StateGraph.h"
+#include <algorithm>
+#include <numeric>
+
+std::size_t MemoryUsage::GetTotal() const
+{
+	return stateBytes + transitionBytes + timestampBytes + traceBytes;
+}
+
+uint32_t StateGraph::GetStateCount() const
+{
+	return static_cast<uint32_t>(m_states.size());
+}
+
+State& StateGraph::GetState(uint32_t state)
+{
+	return m_states[state];
+}
+
+const State& StateGraph::GetState(uint32_t state) const
+{
+	return m_states[state];
+}
+
+uint32_t StateGraph::GetStartState() const
+{
+	return m_startState;
+}
+
+uint32_t StateGraph::FindState(uint64_t index) const
+{
+	if (index >= m_indexTable.size())
+		return NoState;
+
+	return m_indexTable[index];
+}
+
+const std::vector<uint32_t>& StateGraph::GetStatesByIndex() const
+{
+	return m_statesByIndex;
+}
+
+void StateGraph::RenumberStates()
+{
+	uint32_t count = 0;
+	for (auto state : m_statesByIndex)
+		m_states[state].index = count++;
+
+	m_indexTable = m_statesByIndex;
+}
+
+uint32_t StateGraph::GetTransitionCount() const
+{
+	return static_cast<uint32_t>(m_targets.size());
+}
+
+uint32_t StateGraph::TransitionsBegin(uint32_t state) const
+{
+	return m_offsets[state];
+}
+
+uint32_t StateGraph::TransitionsEnd(uint32_t state) const
+{
+	return m_offsets[state + 1];
+}
+
+uint32_t StateGraph::GetOutdegree(uint32_t state) const
+{
+	return m_offsets[state + 1] - m_offsets[state];
+}
+
+uint32_t StateGraph::GetTarget(uint32_t transition) const
+{
+	return m_targets[transition];
+}
+
+TimestampRange StateGraph::GetTimestamps(uint32_t transition) const
+{
+	return m_timestamps.Get(transition);
+}
+
+const TimingStatistics& StateGraph::GetStatistics(uint32_t transition) const
+{
+	return m_statistics[transition];
+}
+
+std::size_t StateGraph::GetByteCount() const
+{
+	return GetMemoryUsage().GetTotal();
+}
+
+MemoryUsage StateGraph::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.stateBytes = m_states.capacity() * sizeof(State)
+		+ m_offsets.capacity() * sizeof(uint32_t)
+		+ (m_indexTable.capacity() + m_statesByIndex.capacity()) * sizeof(uint32_t);
+	usage.transitionBytes = m_targets.capacity() * sizeof(uint32_t)
+		+ std::accumulate(m_statistics.begin(), m_statistics.end(), std::size_t(0),
+			[](std::size_t bytes, const TimingStatistics& statistics) { return bytes + statistics.GetByteCount(); })
+		+ (m_statistics.capacity() - m_statistics.size()) * sizeof(TimingStatistics);
+	usage.timestampBytes = m_timestamps.GetByteCount();
+	return usage;
+}
+
+void StateGraph::BuildIndexTable()
+{
+	uint64_t maxIndex = 0;
+	for (auto& state : m_states)
+		maxIndex = std::max(maxIndex, state.index);
+
+	m_indexTable.assign(m_states.empty() ? 0 : maxIndex + 1, NoState);
+	for (uint32_t state = 0; state < m_states.size(); ++state)
+		m_indexTable[m_states[state].index] = state;
+
+	m_statesByIndex.clear();
+	m_statesByIndex.reserve(m_states.size());
+	for (auto state : m_indexTable)
+		if (state != NoState)
+			m_statesByIndex.push_back(state);
+}
+
+uint32_t StateGraph::FindTransition(uint32_t source, uint32_t target) const
+{
+	auto begin = m_targets.begin() + m_offsets[source];
+	auto end = m_targets.begin() + m_offsets[source + 1];
+	auto it = std::lower_bound(begin, end, target);
+
+	if (it == end || *it != target)
+		return NoTransition;
+
+	return static_cast<uint32_t>(it - m_targets.begin());
+}
+
+StateGraphBuilder::StateGraphBuilder()
+	: m_pool(std::make_unique<std::pmr::unsynchronized_pool_resource>())
+{
+}
+
+StateGraphBuilder::StateGraphBuilder(StateGraph&& graph)
+	: StateGraphBuilder()
+{
+	m_states = std::move(graph.m_states);
+	m_startState = graph.m_startState;
+
+	m_transitions.reserve(m_states.size());
+	for (uint32_t state = 0; state < m_states.size(); ++state)
+	{
+		auto& transitions = m_transitions.emplace_back(m_pool.get());
+		for (auto transition = graph.m_offsets[state]; transition < graph.m_offsets[state + 1]; ++transition)
+		{
+			// Decoded straight into the pool
+			auto range = graph.m_timestamps.Get(transition);
+			auto& times = transitions.try_emplace(transitions.end(), graph.m_targets[transition])->second;
+			times.timestamps.reserve(range.size());
+			times.timestamps.assign(range.begin(), range.end());
+			times.statistics = std::move(graph.m_statistics[transition]);
+		}
+	}
+
+	graph = StateGraph();
+}
+
+StateGraphBuilder& StateGraphBuilder::operator=(StateGraphBuilder&& other) noexcept
+{
+	m_transitions = std::move(other.m_transitions);
+	m_states = std::move(other.m_states);
+	m_startState = other.m_startState;
+	m_pool = std::move(other.m_pool);
+	return *this;
+}
+
+uint32_t StateGraphBuilder::AddState(const State& state)
+{
+	m_states.push_back(state);
+	m_transitions.emplace_back(m_pool.get());
+	return static_cast<uint32_t>(m_states.size() - 1);
+}
+
+uint32_t StateGraphBuilder::GetStateCount() const
+{
+	return static_cast<uint32_t>(m_states.size());
+}
+
+State& StateGraphBuilder::GetState(uint32_t state)
+{
+	return m_states[state];
+}
+
+StateGraphBuilder::TransitionMap& StateGraphBuilder::GetTransitions(uint32_t state)
+{
+	return m_transitions[state];
+}
+
+uint32_t StateGraphBuilder::GetStartState() const
+{
+	return m_startState;
+}
+
+void StateGraphBuilder::SetStartState(uint32_t state)
+{
+	m_startState = state;
+}
+
+uint64_t StateGraphBuilder::RemoveStates(const std::function<bool(uint32_t)>& remove)
+{
+	// Decide for all states first, as the predicate may look at any state
+	std::vector<uint32_t> newIds(m_states.size(), StateGraph::NoState);
+	uint32_t count = 0;
+	for (uint32_t state = 0; state < m_states.size(); ++state)
+		if (!remove(state))
+			newIds[state] = count++;
+
+	uint64_t removed = m_states.size() - count;
+	if (removed == 0)
+		return 0;
+
+	for (uint32_t state = 0; state < m_states.size(); ++state)
+	{
+		auto newId = newIds[state];
+		if (newId == StateGraph::NoState)
+			continue;
+
+		// The ids only decrease, so the transitions stay sorted
+		TransitionMap transitions(m_pool.get());
+		for (auto& [target, times] : m_transitions[state])
+			if (newIds[target] != StateGraph::NoState)
+				transitions.emplace_hint(transitions.end(), newIds[target], std::move(times));
+
+		m_states[newId] = m_states[state];
+		m_transitions[newId] = std::move(transitions);
+	}
+
+	m_states.resize(count);
+	m_transitions.resize(count);
+
+	m_startState = m_startState == StateGraph::NoState ? StateGraph::NoState : newIds[m_startState];
+
+	return removed;
+}
+
+std::size_t StateGraphBuilder::RetainTimestamps(std::size_t count, uint64_t oldest)
+{
+	std::size_t maxCount = 0;
+	for (auto& transitions : m_transitions)
+	{
+		for (auto& [target, times] : transitions)
+		{
+			auto& timestamps = times.timestamps;
+			::RetainTimestamps(timestamps, count, oldest);
+			if (timestamps.capacity() > 2 * timestamps.size())
+				timestamps.shrink_to_fit();
+			maxCount = std::max(maxCount, timestamps.size());
+		}
+	}
+	return maxCount;
+}
+
+MemoryUsage StateGraphBuilder::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.stateBytes = m_states.capacity() * sizeof(State) + m_transitions.capacity() * sizeof(TransitionMap);
+	for (auto& transitions : m_transitions)
+	{
+		for (auto& [target, times] : transitions)
+		{
+			usage.transitionBytes += TransitionByteCount + times.statistics.GetByteCount() - sizeof(TimingStatistics);
+			usage.timestampBytes += times.timestamps.capacity() * sizeof(uint64_t);
+		}
+	}
+	return usage;
+}
+
+StateGraph StateGraphBuilder::Freeze()
+{
+	StateGraph graph;
+
+	std::size_t transitionCount = 0;
+	for (auto& transitions : m_transitions)
+		transitionCount += transitions.size();
+
+	graph.m_offsets.reserve(m_states.size() + 1);
+	graph.m_targets.reserve(transitionCount);
+	graph.m_statistics.reserve(transitionCount);
+
+	graph.m_offsets.push_back(0);
+	for (auto& transitions : m_transitions)
+	{
+		for (auto& [target, times] : transitions)
+		{
+			graph.m_targets.push_back(target);
+			graph.m_timestamps.Append(times.timestamps);
+			graph.m_statistics.push_back(std::move(times.statistics));
+			times.timestamps.clear();
+			times.timestamps.shrink_to_fit();
+		}
+		graph.m_offsets.push_back(static_cast<uint32_t>(graph.m_targets.size()));
+	}
+	graph.m_timestamps.ShrinkToFit();
+
+	graph.m_states = std::move(m_states);
+	graph.m_startState = m_startState;
+	graph.BuildIndexTable();
+
+	*this = StateGraphBuilder();
+
+	return graph;
+}
+
+std::pmr::memory_resource* StateGraphBuilder::GetMemoryResource() const
+{
+	return m_pool.get();
+}
+
+StateGraph StateGraphBuilder::Snapshot() const
+{
+	StateGraph graph;
+
+	graph.m_offsets.reserve(m_states.size() + 1);
+	graph.m_offsets.push_back(0);
+	for (auto& transitions : m_transitions)
+	{
+		for (auto& [target, times] : transitions)
+		{
+			graph.m_targets.push_back(target);
+			graph.m_timestamps.Append(times.timestamps);
+			graph.m_statistics.push_back(times.statistics);
+		}
+		graph.m_offsets.push_back(static_cast<uint32_t>(graph.m_targets.size()));
+	}
+	graph.m_targets.shrink_to_fit();
+	graph.m_statistics.shrink_to_fit();
+	graph.m_timestamps.ShrinkToFit();
+
+	graph.m_states = m_states;
+	graph.m_startState = m_startState;
+	graph.BuildIndexTable();
+
+	return graph;
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include "StateValuesRegistry.h"
+#include "TimestampColumn.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+struct State
+{
+	uint32_t valueId = StateValuesRegistry::NoState;
+	uint64_t index = 0;
+	uint64_t indegree = 0;
+};
+
+/// <summary>
+/// Bytes used by a machine, split into its states, its transitions and their timestamps
+/// </summary>
+struct MemoryUsage
+{
+	// The states, their index and, for a machine, its state values
+	std::size_t stateBytes = 0;
+	// The transitions with their statistics
+	std::size_t transitionBytes = 0;
+	std::size_t timestampBytes = 0;
+	// The trace of the run, that a machine records while learning
+	std::size_t traceBytes = 0;
+
+	std::size_t GetTotal() const;
+};
+
+/// <summary>
+/// Frozen state graph. The states are dense indices, the transitions of all states
+/// are stored in compressed sparse rows, sorted by their target.
+/// The timestamps of the transitions are encoded in one column, next to their statistics.
+/// </summary>
+class StateGraph
+{
+public:
+	static constexpr uint32_t NoState = UINT32_MAX;
+	static constexpr uint32_t NoTransition = UINT32_MAX;
+
+public:
+	uint32_t GetStateCount() const;
+
+	State& GetState(uint32_t state);
+	const State& GetState(uint32_t state) const;
+
+	uint32_t GetStartState() const;
+
+	/// <summary>
+	/// Constant time lookup in the index table
+	/// </summary>
+	/// <returns>The state with the index or NoState</returns>
+	uint32_t FindState(uint64_t index) const;
+
+	/// <summary>
+	/// All states ordered by their index
+	/// </summary>
+	const std::vector<uint32_t>& GetStatesByIndex() const;
+
+	/// <summary>
+	/// Numbers the states consecutively in the order of their indices
+	/// </summary>
+	void RenumberStates();
+
+	uint32_t GetTransitionCount() const;
+
+	/// <summary>
+	/// The transitions of a state are [TransitionsBegin, TransitionsEnd)
+	/// </summary>
+	uint32_t TransitionsBegin(uint32_t state) const;
+	uint32_t TransitionsEnd(uint32_t state) const;
+
+	uint32_t GetOutdegree(uint32_t state) const;
+
+	uint32_t GetTarget(uint32_t transition) const;
+
+	TimestampRange GetTimestamps(uint32_t transition) const;
+
+	/// <summary>
+	/// Summary of the timestamps of the transition, read without decoding them
+	/// </summary>
+	const TimingStatistics& GetStatistics(uint32_t transition) const;
+
+	/// <summary>
+	/// Memory of the states, the transitions and their timestamps
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+	MemoryUsage GetMemoryUsage() const;
+
+	/// <summary>
+	/// Binary search in the transitions of the source
+	/// </summary>
+	uint32_t FindTransition(uint32_t source, uint32_t target) const;
+
+private:
+	friend class StateGraphBuilder;
+
+	void BuildIndexTable();
+
+	std::vector<State> m_states;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint32_t> m_targets;
+	TimestampColumn m_timestamps;
+	std::vector<TimingStatistics> m_statistics;
+	uint32_t m_startState = NoState;
+	// The state of every index, indices of removed states are NoState
+	std::vector<uint32_t> m_indexTable;
+	std::vector<uint32_t> m_statesByIndex;
+};
+
+/// <summary>
+/// Mutable state graph used while states are added or the passes rewrite transitions
+/// </summary>
+class StateGraphBuilder
+{
+public:
+	using TransitionMap = std::pmr::map<uint32_t, TransitionTimes>;
+
+	// Memory of a state and of a transition in its map with the links and the color of the tree node,
+	// without the timestamps and the buckets of the statistics
+	static constexpr std::size_t StateByteCount = sizeof(State) + sizeof(TransitionMap);
+	static constexpr std::size_t TransitionByteCount = sizeof(TransitionMap::value_type) + 4 * sizeof(void*);
+
+public:
+	StateGraphBuilder();
+
+	/// <summary>
+	/// Thaws a frozen graph, the graph is left empty
+	/// </summary>
+	explicit StateGraphBuilder(StateGraph&& graph);
+
+	StateGraphBuilder(StateGraphBuilder&& other) = default;
+
+	/// <summary>
+	/// Releases the transitions before the pool they were allocated from
+	/// </summary>
+	StateGraphBuilder& operator=(StateGraphBuilder&& other) noexcept;
+
+public:
+	uint32_t AddState(const State& state);
+
+	uint32_t GetStateCount() const;
+
+	State& GetState(uint32_t state);
+
+	TransitionMap& GetTransitions(uint32_t state);
+
+	uint32_t GetStartState() const;
+
+	void SetStartState(uint32_t state);
+
+	/// <summary>
+	/// Removes all states for which remove returns true and the transitions into them.
+	/// The remaining states keep their order.
+	/// </summary>
+	/// <returns>The number of removed states</returns>
+	uint64_t RemoveStates(const std::function<bool(uint32_t)>& remove);
+
+	/// <summary>
+	/// Applies RetainTimestamps to every transition and releases the memory of the dropped timestamps
+	/// </summary>
+	/// <returns>The most timestamps kept by one transition</returns>
+	std::size_t RetainTimestamps(std::size_t count, uint64_t oldest);
+
+	/// <summary>
+	/// Memory of the states, the transition maps and the timestamps in the pool
+	/// </summary>
+	MemoryUsage GetMemoryUsage() const;
+
+	/// <summary>
+	/// Moves the states and transitions into compressed sparse rows and encodes the timestamps.
+	/// The builder is left empty.
+	/// </summary>
+	StateGraph Freeze();
+
+	/// <summary>
+	/// Packs a copy of the states and transitions, the builder keeps them
+	/// </summary>
+	StateGraph Snapshot() const;
+
+	/// <summary>
+	/// The pool of the transitions. Maps moved into the builder should use it, to avoid a copy.
+	/// </summary>
+	std::pmr::memory_resource* GetMemoryResource() const;
+
+private:
+	// Owns the nodes of all transition maps and their timestamps, released at once with the builder.
+	// Held by pointer, so that the pool keeps its address when the builder is moved.
+	std::unique_ptr<std::pmr::unsynchronized_pool_resource> m_pool;
+	std::vector<State> m_states;
+	std::vector<TransitionMap> m_transitions;
+	uint32_t m_startState = StateGraph::NoState;
+};
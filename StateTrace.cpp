@@ -0,0 +1,174 @@
+#include "StateTrace.h"
+#include <algorithm>
+
+namespace
+{
+	void AppendVarint(std::vector<unsigned char>& bytes, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.push_back(static_cast<unsigned char>(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back(static_cast<unsigned char>(value));
+	}
+
+	uint64_t ReadVarint(const unsigned char*& bytes)
+	{
+		uint64_t value = 0;
+		unsigned int shift = 0;
+		unsigned char byte;
+		do {
+			byte = *bytes++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		return value;
+	}
+
+	// The timestamps of a log may step back, so the differences keep their sign
+	void AppendDelta(std::vector<unsigned char>& bytes, uint64_t from, uint64_t to)
+	{
+		auto delta = static_cast<int64_t>(to - from);
+		AppendVarint(bytes, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+	}
+}
+
+StateTrace::Iterator::Iterator(const unsigned char* bytes, std::size_t remaining)
+	: m_bytes(bytes)
+	, m_remaining(remaining)
+{
+	if (m_remaining != 0)
+		Decode();
+}
+
+StateTrace::Iterator& StateTrace::Iterator::operator++()
+{
+	if (--m_remaining != 0)
+		Decode();
+	return *this;
+}
+
+StateTrace::Iterator StateTrace::Iterator::operator++(int)
+{
+	auto copy = *this;
+	++*this;
+	return copy;
+}
+
+void StateTrace::Iterator::Decode()
+{
+	m_step.state = static_cast<uint32_t>(ReadVarint(m_bytes));
+	auto delta = ReadVarint(m_bytes);
+	m_step.timestamp += (delta >> 1) ^ (0 - (delta & 1));
+}
+
+void StateTrace::Append(uint32_t state, uint64_t timestamp)
+{
+	AppendVarint(m_bytes, state);
+	AppendDelta(m_bytes, m_lastTimestamp, timestamp);
+	m_lastTimestamp = timestamp;
+	++m_size;
+}
+
+void StateTrace::Append(const StateTrace& other, const std::vector<uint32_t>& newIds)
+{
+	m_bytes.reserve(m_bytes.size() + other.m_bytes.size());
+	for (auto& step : other)
+		Append(newIds[step.state], step.timestamp);
+}
+
+void StateTrace::Clear()
+{
+	m_bytes.clear();
+	m_bytes.shrink_to_fit();
+	m_size = 0;
+	m_lastTimestamp = 0;
+}
+
+void StateTrace::ShrinkToFit()
+{
+	m_bytes.shrink_to_fit();
+}
+
+StateTrace::Iterator StateTrace::begin() const
+{
+	return Iterator(m_bytes.data(), m_size);
+}
+
+StateTrace::Iterator StateTrace::end() const
+{
+	return Iterator();
+}
+
+std::size_t StateTrace::size() const
+{
+	return m_size;
+}
+
+bool StateTrace::empty() const
+{
+	return m_size == 0;
+}
+
+std::size_t StateTrace::GetByteCount() const
+{
+	return m_bytes.capacity();
+}
+
+StateTrace StateTrace::Replay(const StateGraph& graph, uint32_t startState, uint64_t startTime /*= 0*/)
+{
+	StateTrace trace;
+	if (startState == StateGraph::NoState)
+		return trace;
+
+	struct Event
+	{
+		uint64_t timestamp;
+		uint32_t target;
+	};
+
+	// The times of all transitions of a state in one list, equal times stay in the order of the transitions
+	std::vector<Event> events;
+	std::vector<std::size_t> offsets(graph.GetStateCount() + 1, 0);
+	for (uint32_t state = 0; state < graph.GetStateCount(); ++state)
+	{
+		offsets[state] = events.size();
+		for (auto transition = graph.TransitionsBegin(state); transition != graph.TransitionsEnd(state); ++transition)
+			for (auto timestamp : graph.GetTimestamps(transition))
+				events.push_back({ timestamp, graph.GetTarget(transition) });
+
+		if (graph.GetOutdegree(state) > 1)
+			std::stable_sort(events.begin() + offsets[state], events.end(),
+				[](const Event& left, const Event& right) { return left.timestamp < right.timestamp; });
+	}
+	offsets.back() = events.size();
+
+	// The next unread time of every state
+	std::vector<std::size_t> cursors(offsets.begin(), offsets.end() - 1);
+
+	auto state = startState;
+	auto time = startTime;
+	trace.Append(state, time);
+
+	while (true)
+	{
+		auto& cursor = cursors[state];
+		auto end = offsets[state + 1];
+		while (cursor != end && events[cursor].timestamp <= time)
+			++cursor;
+
+		if (cursor == end)
+			break;
+
+		auto next = cursor;
+		while (next + 1 != end && events[next + 1].timestamp == events[cursor].timestamp)
+			++next;
+
+		state = events[next].target;
+		time = events[next].timestamp;
+		trace.Append(state, time);
+	}
+
+	return trace;
+}
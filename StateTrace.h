@@ -0,0 +1,94 @@
+#pragma once
+#include "StateGraph.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/// <summary>
+/// The run through the states of a machine: every state it entered with the timestamp of the frame.
+/// Every step is stored as two LEB128 varints, the state and the difference to the previous timestamp
+/// in zigzag encoding, so a step of a log takes a few bytes.
+/// </summary>
+class StateTrace
+{
+public:
+	struct Step
+	{
+		uint32_t state = StateGraph::NoState;
+		uint64_t timestamp = 0;
+	};
+
+	/// <summary>
+	/// Decodes one step after another
+	/// </summary>
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Step;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Step*;
+		using reference = const Step&;
+
+	public:
+		Iterator() = default;
+		Iterator(const unsigned char* bytes, std::size_t remaining);
+
+		reference operator*() const { return m_step; }
+		pointer operator->() const { return &m_step; }
+
+		Iterator& operator++();
+		Iterator operator++(int);
+
+		bool operator==(const Iterator& other) const { return m_remaining == other.m_remaining; }
+		bool operator!=(const Iterator& other) const { return m_remaining != other.m_remaining; }
+
+	private:
+		void Decode();
+
+	private:
+		const unsigned char* m_bytes = nullptr;
+		std::size_t m_remaining = 0;
+		Step m_step;
+	};
+
+public:
+	void Append(uint32_t state, uint64_t timestamp);
+
+	/// <summary>
+	/// Appends the steps of another trace, with the states renamed by newIds
+	/// </summary>
+	void Append(const StateTrace& other, const std::vector<uint32_t>& newIds);
+
+	void Clear();
+
+	/// <summary>
+	/// Releases the spare capacity, once the run is complete
+	/// </summary>
+	void ShrinkToFit();
+
+	Iterator begin() const;
+	Iterator end() const;
+
+	std::size_t size() const;
+	bool empty() const;
+
+	/// <summary>
+	/// Memory of the encoded steps
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+	/// <summary>
+	/// Reconstructs the run from the timestamps of the transitions. From every state it takes the transition
+	/// with the earliest later timestamp, of equal ones the last transition, and it ends where no later one is left.
+	/// The times of every state are sorted once and only read forward, as the time of the run only grows,
+	/// so the replay is linear in the timestamps.
+	/// </summary>
+	static StateTrace Replay(const StateGraph& graph, uint32_t startState, uint64_t startTime = 0);
+
+private:
+	std::vector<unsigned char> m_bytes;
+	std::size_t m_size = 0;
+	uint64_t m_lastTimestamp = 0;
+};
@@ -1,187 +1,477 @@
 #include "StateValuesRegistry.h"
+#include "ImageKernels.h"
+#include <algorithm>
+#include <cstring>
 
-StateValuesRegistry::StateValuesRegistry(Participant** participants, unsigned short participantCount, bool isInput)
-#ifdef COUNT_DUPLICATES
-	: m_duplicateStates(0)
-#endif
+template<class StatePolicy, class DuplicatePolicy>
+BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::BasicStateValuesRegistry()
 {
-	InitRegistry(participants, participantCount, isInput);
 }
 
-void StateValuesRegistry::InitRegistry(Participant** participants, unsigned short participantCount, bool isInput)
+template<class StatePolicy, class DuplicatePolicy>
+void BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::InitRegistry(std::span<const Change> changes, bool isInput)
 {
 	auto& registry = isInput ? m_inputRegistry : m_outputRegistry;
-	registry.participantCount = participantCount;
-	registry.values = new std::set<participant_ptr_t, SmartCmp>[participantCount];
-	registry.current = participants;
+
+	// The participant ids count down from 0, so their negation is the index.
+	// Ids far from 0 get the slots after the dense ones, instead of sizing the image by their negation.
+	uint32_t denseCount = 0;
+	std::vector<unsigned short> sparseIds;
+	for (auto& change : changes)
+	{
+		uint32_t idx = static_cast<uint16_t>(0 - change.participantId);
+		if (idx < Registry::DenseIndexLimit)
+			denseCount = std::max(denseCount, idx + 1);
+		else
+			sparseIds.push_back(change.participantId);
+	}
+
+	std::sort(sparseIds.begin(), sparseIds.end());
+	sparseIds.erase(std::unique(sparseIds.begin(), sparseIds.end()), sparseIds.end());
+
+	uint32_t count = denseCount + static_cast<uint32_t>(sparseIds.size());
+	registry.participantCount = count;
+	registry.denseCount = denseCount;
+	registry.slots.assign(count, {});
+
+	registry.participantIds.resize(denseCount);
+	for (uint32_t i = 0; i < denseCount; ++i)
+		registry.participantIds[i] = static_cast<unsigned short>(0 - i);
+	registry.participantIds.insert(registry.participantIds.end(), sparseIds.begin(), sparseIds.end());
+
+	for (auto& change : changes)
+	{
+		auto& slot = registry.slots[registry.FindSlot(change.participantId)];
+		slot.byteCount = change.byteCount;
+		slot.isUsed = true;
+	}
+
+	std::size_t imageSize = 0;
+	for (auto& slot : registry.slots)
+	{
+		slot.offset = imageSize;
+		imageSize += slot.byteCount;
+	}
+
+	registry.image.assign(imageSize, 0);
+	registry.participantHashes.assign(count, 0);
+	registry.hash = 0;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		auto& slot = registry.slots[i];
+		if (!slot.isUsed)
+			continue;
+
+		registry.participantHashes[i] = HashParticipant(static_cast<uint16_t>(i), registry.image.data() + slot.offset, slot.byteCount);
+		registry.hash ^= registry.participantHashes[i];
+	}
+
+	for (auto& change : changes)
+		ChangeValues(registry, change);
+
+	registry.images.SetImageSize(imageSize);
+
+	if constexpr (StatePolicy::IsCombined)
+		m_combinedImages.SetImageSize(2 * sizeof(uint32_t));
 }
 
-StateValuesRegistry::~StateValuesRegistry()
+template<class StatePolicy, class DuplicatePolicy>
+BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::~BasicStateValuesRegistry()
 {
-	for (unsigned short i = 0; 0 < m_inputRegistry.participantCount; ++i)
-		delete m_inputRegistry.current[i];
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::ChangeValues(Registry& registry, const Change& change)
+{
+	auto idx = registry.FindSlot(change.participantId);
+	if (idx >= registry.participantCount || !registry.slots[idx].isUsed)
+		return;
+
+	auto& slot = registry.slots[idx];
+	auto participantBytes = registry.image.data() + slot.offset;
+	auto byteCount = std::min(slot.byteCount, change.byteCount);
 
-	delete[] m_inputRegistry.values;
+	// Logs repeat unchanged participants, which keep their hash
+	if (ImageKernels::Equal(participantBytes, change.bytes, byteCount))
+		return;
 
-	for (unsigned short i = 0; 0 < m_outputRegistry.participantCount; ++i)
-		delete m_outputRegistry.current[i];
+	memcpy(participantBytes, change.bytes, byteCount);
 
-	delete[] m_outputRegistry.values;
+	auto participantHash = HashParticipant(static_cast<uint16_t>(idx), participantBytes, slot.byteCount);
+	registry.hash ^= registry.participantHashes[idx] ^ participantHash;
+	registry.participantHashes[idx] = participantHash;
 }
 
-StateValuesRegistry* StateValuesRegistry::s_instance = nullptr;
+template<class StatePolicy, class DuplicatePolicy>
+uint64_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::HashParticipant(uint16_t idx, const unsigned char* bytes, unsigned int byteCount)
+{
+	// Every participant gets its own seed, so equal bytes of different participants do not cancel out
+	return ProcessImageTable::Hash(bytes, byteCount, ProcessImageTable::Hash(reinterpret_cast<const unsigned char*>(&idx), sizeof(idx)));
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+std::pair<uint32_t, bool> BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::InternCurrentImage(Registry& registry)
+{
+	// The table verifies the bytes on equal hashes, so collisions cannot merge states
+	return registry.images.Intern(registry.image.data(), registry.hash);
+}
 
-std::vector<participant_ptr_t> StateValuesRegistry::FindCurrentValues(bool isInput)
+template<class StatePolicy, class DuplicatePolicy>
+uint32_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::FindCurrentValues(bool isInput)
 {
 	auto& registry = isInput ? m_inputRegistry : m_outputRegistry;
 
-#ifdef COUNT_DUPLICATES
-	for (auto& values : registry.states)
+	auto [imageId, isNew] = InternCurrentImage(registry);
+
+	if constexpr (DuplicatePolicy::IsCounted)
 	{
-		bool isEqual = true;
-		for (unsigned short i = 0; i < registry.participantCount; ++i)
-		{
-			if ((*registry.current[i]) != (*values[i]))
-			{
-				isEqual = false;
-				break;
-			}
-		}
+		if (!isNew)
+			++m_duplicateStates;
+	}
 
-		if (isEqual)
+	// The combined states are registered by FindCombinedValues
+	if constexpr (StatePolicy::IsCombined)
+		return imageId;
+	else
+	{
+		if (isNew)
 		{
-			++m_duplicateStates;
-			return values;
+			registry.stateValueIds.push_back(static_cast<uint32_t>(m_stateImages.size()));
+			m_stateImages.push_back({ isInput, imageId });
 		}
+
+		return registry.stateValueIds[imageId];
 	}
-#endif
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+uint32_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::FindCombinedValues() requires StatePolicy::IsCombined
+{
+	// Both images are interned, so the pair of their ids identifies the combined state
+	uint32_t imageIds[2] = { FindCurrentValues(true), FindCurrentValues(false) };
+
+	auto [imageId, isNew] = m_combinedImages.Intern(reinterpret_cast<const unsigned char*>(imageIds));
 
-	std::vector<participant_ptr_t> newState;
+	if (isNew)
+		m_stateImages.push_back({ true, imageId });
+
+	return imageId;
+}
 
-	for (unsigned short i = 0; i < registry.participantCount; ++i)
+template<class StatePolicy, class DuplicatePolicy>
+uint32_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetStateValues(bool isInput, std::span<const Change> changes)
+{
+	auto& registry = isInput ? m_inputRegistry : m_outputRegistry;
+
+	// The first frame of a direction defines its participants
+	if (registry.participantCount == 0)
+		InitRegistry(changes, isInput);
+	else
 	{
-		auto currentValue = std::make_shared<const Participant>(*registry.current[i]);
+		for (auto& change : changes)
+			ChangeValues(registry, change);
+	}
 
-		auto findIt = registry.values[i].find(currentValue);
+	if constexpr (StatePolicy::IsCombined)
+	{
+		if (m_inputRegistry.participantCount == 0 || m_outputRegistry.participantCount == 0)
+			return NoState;
 
-		if (findIt != registry.values[i].end())
-		{
-			newState.push_back(*findIt);
-			continue;
-		}
-		
-		registry.values[i].insert(currentValue);
-		newState.push_back(currentValue);
+		return FindCombinedValues();
 	}
+	else
+		return FindCurrentValues(isInput);
+}
 
-#ifdef COUNT_DUPLICATES
-	registry.states.push_back(newState);
-#endif
+template<class StatePolicy, class DuplicatePolicy>
+bool BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::IsInputState(uint32_t stateValueId) const
+{
+	if (stateValueId >= m_stateImages.size())
+		return false;
+	return m_stateImages[stateValueId].isInput;
+}
 
-	return newState;
+template<class StatePolicy, class DuplicatePolicy>
+bool BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::IsInitialized(bool isInput) const
+{
+	return (isInput ? m_inputRegistry : m_outputRegistry).participantCount != 0;
 }
 
-std::vector<participant_ptr_t> StateValuesRegistry::GetStateValues(bool isInput, const std::vector<Change>& changes)
+template<class StatePolicy, class DuplicatePolicy>
+void BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::Resume(bool isInput, std::span<const Change> firstChanges, std::span<const Change> currentValues)
 {
-	bool createNew = s_instance ?
-		(isInput ? s_instance->m_inputRegistry.participantCount : s_instance->m_outputRegistry.participantCount) == 0
-		: true;
+	InitRegistry(firstChanges, isInput);
+
+	auto& registry = isInput ? m_inputRegistry : m_outputRegistry;
+	for (auto& change : currentValues)
+		ChangeValues(registry, change);
+}
 
-	if (createNew)
+template<class StatePolicy, class DuplicatePolicy>
+std::vector<uint32_t> BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::Merge(const BasicStateValuesRegistry& shard)
+{
+	std::size_t newImages = 0;
+	std::size_t shardImages = 0;
+
+	// Returns the id in this registry of every image of the shard
+	auto mergeImages = [&newImages, &shardImages](Registry& registry, const Registry& shardRegistry)
 	{
-		auto count = static_cast<uint16_t>(changes.size());
-		Participant** participants = createNew ? new Participant*[count] : nullptr;
+		if (shardRegistry.participantCount == 0)
+			return std::vector<uint32_t>();
 
-		for (auto& change : changes)
+		if (registry.participantCount == 0)
 		{
-			uint16_t idx = 0 - change.participantId;
+			registry.participantCount = shardRegistry.participantCount;
+			registry.denseCount = shardRegistry.denseCount;
+			registry.slots = shardRegistry.slots;
+			registry.participantIds = shardRegistry.participantIds;
+			registry.images.SetImageSize(shardRegistry.images.GetImageSize());
+		}
+
+		// The shard ends with the current image of the log
+		registry.image = shardRegistry.image;
+		registry.hash = shardRegistry.hash;
+		registry.participantHashes = shardRegistry.participantHashes;
+
+		std::vector<uint32_t> imageIds;
+		imageIds.reserve(shardRegistry.images.GetImageCount());
+		for (uint32_t id = 0; id < shardRegistry.images.GetImageCount(); ++id)
+		{
+			// Both hashes are rolling hashes of the same layout, so they can be reused
+			auto [imageId, isNew] = registry.images.Intern(shardRegistry.images.GetImage(id), shardRegistry.images.GetHash(id));
+			imageIds.push_back(imageId);
+			if (isNew)
+				++newImages;
+		}
+		shardImages += imageIds.size();
+
+		return imageIds;
+	};
 
-			if (idx >= count)
+	auto inputIds = mergeImages(m_inputRegistry, shard.m_inputRegistry);
+	auto outputIds = mergeImages(m_outputRegistry, shard.m_outputRegistry);
+
+	std::vector<uint32_t> stateValueIds;
+	stateValueIds.reserve(shard.m_stateImages.size());
+
+	if constexpr (StatePolicy::IsCombined)
+	{
+		if (m_combinedImages.GetImageSize() == 0)
+			m_combinedImages.SetImageSize(2 * sizeof(uint32_t));
+
+		for (auto& stateImage : shard.m_stateImages)
+		{
+			uint32_t imageIds[2];
+			memcpy(imageIds, shard.m_combinedImages.GetImage(stateImage.imageId), sizeof(imageIds));
+			imageIds[0] = inputIds[imageIds[0]];
+			imageIds[1] = outputIds[imageIds[1]];
+
+			auto [imageId, isNew] = m_combinedImages.Intern(reinterpret_cast<const unsigned char*>(imageIds));
+			if (isNew)
+				m_stateImages.push_back({ true, imageId });
+
+			stateValueIds.push_back(imageId);
+		}
+	}
+	else
+	{
+		for (auto& stateImage : shard.m_stateImages)
+		{
+			auto& registry = stateImage.isInput ? m_inputRegistry : m_outputRegistry;
+			auto imageId = (stateImage.isInput ? inputIds : outputIds)[stateImage.imageId];
+
+			// The images are merged in order, so a new image is the next one of its registry
+			if (imageId == registry.stateValueIds.size())
 			{
-				auto oldArray = participants;
-				participants = new Participant * [idx + 1];
-				memcpy(participants, oldArray, count);
-				count = idx + 1;
-				delete[] oldArray;
+				registry.stateValueIds.push_back(static_cast<uint32_t>(m_stateImages.size()));
+				m_stateImages.push_back({ stateImage.isInput, imageId });
 			}
 
-			participants[idx] = new Participant(change.participantId, change.bytes, change.byteCount, isInput);
+			stateValueIds.push_back(registry.stateValueIds[imageId]);
 		}
+	}
 
-		if (!s_instance)
-			s_instance = new StateValuesRegistry(participants, count, isInput);
-		else
-			s_instance->InitRegistry(participants, count, isInput);
+	// Every image looked up in the shard, that was already known here or in the shard
+	if constexpr (DuplicatePolicy::IsCounted)
+	{
+		m_duplicateStates += shard.m_duplicateStates + static_cast<unsigned int>(shardImages - newImages);
+
+		// The shard continued this registry, so its hits are the later ones
+		for (uint32_t id = 0; id < shard.m_stateHits.size(); ++id)
+		{
+			auto& shardHits = shard.m_stateHits[id];
+			if (shardHits.count == 0)
+				continue;
+
+			if (stateValueIds[id] >= m_stateHits.size())
+				m_stateHits.resize(stateValueIds[id] + 1);
+
+			auto& hits = m_stateHits[stateValueIds[id]];
+			if (hits.count == 0)
+				hits.firstTimestamp = shardHits.firstTimestamp;
+			hits.lastTimestamp = shardHits.lastTimestamp;
+			hits.count += shardHits.count;
+		}
+	}
 
-#ifdef COMBINED_STATES
-		if (s_instance->m_inputRegistry.participantCount == 0 || s_instance->m_outputRegistry.participantCount == 0)
-			return {};
+	return stateValueIds;
+}
 
-		auto values = s_instance->FindCurrentValues(true);
-		auto outputValues = s_instance->FindCurrentValues(false);
-		values.insert(values.end(), outputValues.begin(), outputValues.end());
-		return values;
+template<class StatePolicy, class DuplicatePolicy>
+void BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::AppendValues(std::string& outString, const Registry& registry, const unsigned char* image, bool isInput) const
+{
+	for (uint32_t i = 0; i < registry.participantCount; ++i)
+	{
+		auto& slot = registry.slots[i];
+		if (!slot.isUsed)
+			continue;
 
-#else
-		return s_instance->FindCurrentValues(isInput);
-#endif
+		Participant participant(registry.participantIds[i], image + slot.offset, slot.byteCount, isInput);
+		outString += "\n\t" + participant.Print();
 	}
+}
 
-	for (auto& change : changes)
+template<class StatePolicy, class DuplicatePolicy>
+std::string BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::PrintStateValues(uint32_t stateValueId) const
+{
+	if (stateValueId >= m_stateImages.size())
+		return "";
+
+	std::string outString;
+	auto& stateImage = m_stateImages[stateValueId];
+
+	if constexpr (StatePolicy::IsCombined)
 	{
-		auto idx = static_cast<uint16_t>(0 - change.participantId);
-		
-		(isInput ? s_instance->m_inputRegistry : s_instance->m_outputRegistry).current[idx]
-			->ChangeBytes(change.bytes);
+		uint32_t imageIds[2];
+		memcpy(imageIds, m_combinedImages.GetImage(stateImage.imageId), sizeof(imageIds));
+		AppendValues(outString, m_inputRegistry, m_inputRegistry.images.GetImage(imageIds[0]), true);
+		AppendValues(outString, m_outputRegistry, m_outputRegistry.images.GetImage(imageIds[1]), false);
 	}
+	else
+	{
+		auto& registry = stateImage.isInput ? m_inputRegistry : m_outputRegistry;
+		AppendValues(outString, registry, registry.images.GetImage(stateImage.imageId), stateImage.isInput);
+	}
+
+	return outString;
+}
 
-#ifdef COMBINED_STATES
-	if (s_instance->m_inputRegistry.participantCount == 0 || s_instance->m_outputRegistry.participantCount == 0)
+template<class StatePolicy, class DuplicatePolicy>
+std::span<const unsigned char> BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetStateImage(uint32_t stateValueId) const requires (!StatePolicy::IsCombined)
+{
+	if (stateValueId >= m_stateImages.size())
 		return {};
 
-	auto values = s_instance->FindCurrentValues(true);
-	auto outputValues = s_instance->FindCurrentValues(false);
-	values.insert(values.end(), outputValues.begin(), outputValues.end());
-	return values;
+	auto& stateImage = m_stateImages[stateValueId];
+	auto& registry = stateImage.isInput ? m_inputRegistry : m_outputRegistry;
+	return { registry.images.GetImage(stateImage.imageId), registry.images.GetImageSize() };
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+void BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::RecordHit(uint32_t stateValueId, const uint64_t& timestamp) requires DuplicatePolicy::IsCounted
+{
+	// The fixed layout registry resolves the ids before they are copied here, so the size is not bound to m_stateImages
+	if (stateValueId >= m_stateHits.size())
+		m_stateHits.resize(stateValueId + 1);
+
+	auto& hits = m_stateHits[stateValueId];
+	if (hits.count++ == 0)
+		hits.firstTimestamp = timestamp;
+	hits.lastTimestamp = timestamp;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+const std::vector<StateHits>& BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetStateHits() const requires DuplicatePolicy::IsCounted
+{
+	return m_stateHits;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+std::vector<uint32_t> BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetMostFrequentStates(std::size_t count) const requires DuplicatePolicy::IsCounted
+{
+	std::vector<uint32_t> stateValueIds;
+	stateValueIds.reserve(m_stateHits.size());
+	for (uint32_t id = 0; id < m_stateHits.size(); ++id)
+		if (m_stateHits[id].count != 0)
+			stateValueIds.push_back(id);
+
+	auto isMoreFrequent = [this](uint32_t a, uint32_t b)
+	{
+		if (m_stateHits[a].count != m_stateHits[b].count)
+			return m_stateHits[a].count > m_stateHits[b].count;
+		return a < b;
+	};
+
+	count = std::min(count, stateValueIds.size());
+	std::nth_element(stateValueIds.begin(), stateValueIds.begin() + count, stateValueIds.end(), isMoreFrequent);
+	stateValueIds.resize(count);
+	std::sort(stateValueIds.begin(), stateValueIds.end(), isMoreFrequent);
+
+	return stateValueIds;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+unsigned int BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetNumberOfDuplicates() const requires DuplicatePolicy::IsCounted
+{
+	return m_duplicateStates;
+}
+
+template<class StatePolicy, class DuplicatePolicy>
+std::size_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetUniqueInputStates() const requires DuplicatePolicy::IsCounted
+{
+	return m_inputRegistry.images.GetImageCount();
+}
 
-#else
-	return s_instance->FindCurrentValues(isInput);
-#endif
+template<class StatePolicy, class DuplicatePolicy>
+std::size_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetUniqueOutputStates() const requires DuplicatePolicy::IsCounted
+{
+	return m_outputRegistry.images.GetImageCount();
 }
 
-#ifdef COUNT_DUPLICATES
-unsigned int StateValuesRegistry::GetNumberOfDuplicates()
+template<class StatePolicy, class DuplicatePolicy>
+uint32_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetInputParticipantCount() const
 {
-	if (!s_instance)
-		return 0;
-	return s_instance->m_duplicateStates;
+	return m_inputRegistry.participantCount;
 }
 
-std::size_t StateValuesRegistry::GetUniqueInputStates()
+template<class StatePolicy, class DuplicatePolicy>
+uint32_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetOutputParticipantCount() const
 {
-	if (!s_instance)
-		return 0;
-	return s_instance->m_inputRegistry.states.size();
+	return m_outputRegistry.participantCount;
 }
 
-std::size_t StateValuesRegistry::GetUniqueOutputStates()
+template<class StatePolicy, class DuplicatePolicy>
+std::size_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetByteCount() const
 {
-	if (!s_instance)
-		return 0;
-	return s_instance->m_outputRegistry.states.size();
+	return GetImageByteCount() + GetHitByteCount();
 }
-#endif
 
-unsigned short StateValuesRegistry::GetInputParticipantCount()
+template<class StatePolicy, class DuplicatePolicy>
+std::size_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetImageByteCount() const
 {
-	if (!s_instance)
-		return 0;
-	return s_instance->m_inputRegistry.participantCount;
+	auto registryBytes = [](const Registry& registry)
+	{
+		return registry.slots.capacity() * sizeof(ParticipantSlot)
+			+ registry.image.capacity()
+			+ registry.participantIds.capacity() * sizeof(unsigned short)
+			+ registry.participantHashes.capacity() * sizeof(uint64_t)
+			+ registry.images.GetByteCount()
+			+ registry.stateValueIds.capacity() * sizeof(uint32_t);
+	};
+
+	return registryBytes(m_inputRegistry) + registryBytes(m_outputRegistry)
+		+ m_combinedImages.GetByteCount()
+		+ m_stateImages.capacity() * sizeof(StateImage);
 }
 
-unsigned short StateValuesRegistry::GetOutputParticipantCount()
+template<class StatePolicy, class DuplicatePolicy>
+std::size_t BasicStateValuesRegistry<StatePolicy, DuplicatePolicy>::GetHitByteCount() const
 {
-	if (!s_instance)
-		return 0;
-	return s_instance->m_outputRegistry.participantCount;
+	return m_stateHits.capacity() * sizeof(StateHits);
 }
+
+template class BasicStateValuesRegistry<SeparateStates, IgnoreDuplicates>;
+template class BasicStateValuesRegistry<SeparateStates, CountDuplicates>;
+template class BasicStateValuesRegistry<CombinedStates, IgnoreDuplicates>;
+template class BasicStateValuesRegistry<CombinedStates, CountDuplicates>;
@@ -1,71 +1,256 @@
 #pragma once
 #include "Participant.h"
-#include <set>
+#include "ProcessImageTable.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <span>
 #include <vector>
-#include <initializer_list>
 
-//#define COUNT_DUPLICATES
-//#define COMBINED_STATES
+/// <summary>
+/// New values of a participant. The bytes are not owned by the change,
+/// they point into the buffer of the frame source and are copied by the registry.
+/// </summary>
+struct Change
+{
+	unsigned short participantId;
+	unsigned int byteCount;
+	const unsigned char* bytes = nullptr;
+};
+
+/// <summary>
+/// Called by the frame readers of every format for each frame, with the changes of its participants
+/// </summary>
+using FrameCallback = std::function<void(const uint64_t& timestamp, bool isInput, const std::vector<Change>& changes)>;
+
+/// <summary>
+/// Position of a participant in the process image
+/// </summary>
+struct ParticipantSlot
+{
+	std::size_t offset = 0;
+	unsigned int byteCount = 0;
+	bool isUsed = false;
+};
+
+struct Registry
+{
+	// Participants with a smaller negated id are indexed by it
+	static constexpr uint32_t DenseIndexLimit = 1024;
 
-using participant_ptr_t = std::shared_ptr<const Participant>;
+	uint32_t participantCount = 0;
+	// Slots indexed by the negated participant id, the other participants follow them sorted by id
+	uint32_t denseCount = 0;
+	std::vector<ParticipantSlot> slots;
+	// The participant id of every slot
+	std::vector<unsigned short> participantIds;
+	// The current process image, all participants back to back
+	std::vector<unsigned char> image;
+	// Zobrist style hash of the current image, the XOR of all participant hashes
+	uint64_t hash = 0;
+	std::vector<uint64_t> participantHashes;
+	// All unique process images of this direction
+	ProcessImageTable images;
+	// The state value id of every image
+	std::vector<uint32_t> stateValueIds;
 
-struct SmartCmp {
-	bool operator()(participant_ptr_t lhs, participant_ptr_t rhs) const
+	/// <summary>
+	/// The slot of the participant or participantCount, if it is not part of the image
+	/// </summary>
+	uint32_t FindSlot(unsigned short participantId) const
 	{
-		return *lhs < *rhs;
+		uint32_t idx = static_cast<uint16_t>(0 - participantId);
+		if (idx < denseCount)
+			return idx;
+
+		auto begin = participantIds.begin() + denseCount;
+		auto it = std::lower_bound(begin, participantIds.end(), participantId);
+		if (it == participantIds.end() || *it != participantId)
+			return participantCount;
+		return static_cast<uint32_t>(it - participantIds.begin());
 	}
 };
 
-struct Change
+/// <summary>
+/// State policy of separate states, every state has either the input or the output image
+/// </summary>
+struct SeparateStates
 {
-	unsigned short participantId;
-	unsigned int byteCount;
-	unsigned char* bytes = new unsigned char[byteCount];
+	static constexpr bool IsCombined = false;
 };
 
-struct Registry
+/// <summary>
+/// State policy of combined states, every state has the pair of the current input and output image
+/// </summary>
+struct CombinedStates
+{
+	static constexpr bool IsCombined = true;
+};
+
+/// <summary>
+/// Duplicate policy, that does not count anything
+/// </summary>
+struct IgnoreDuplicates
+{
+	static constexpr bool IsCounted = false;
+};
+
+/// <summary>
+/// Duplicate policy, that counts the lookups of images, that were known already
+/// </summary>
+struct CountDuplicates
 {
-	Participant** current = nullptr;
-	unsigned short participantCount = 0;
-#ifdef COUNT_DUPLICATES
-	std::vector<std::vector<participant_ptr_t>> states;
-#endif
-	std::set<participant_ptr_t, SmartCmp>* values = nullptr;
+	static constexpr bool IsCounted = true;
 };
 
 /// <summary>
-/// Singleton Class for keeping track of all possible state values
+/// How often a state value was reached and when, only kept by the CountDuplicates policy
 /// </summary>
-class StateValuesRegistry
+struct StateHits
 {
+	uint64_t count = 0;
+	uint64_t firstTimestamp = 0;
+	uint64_t lastTimestamp = 0;
+};
+
+template<class Layout, class StatePolicy, class DuplicatePolicy>
+class FixedLayoutRegistry;
+
+/// <summary>
+/// Keeps track of all possible state values of one machine.
+/// Every unique process image is interned into a dense state value id.
+/// The policies are resolved at compile time, all of them are instantiated in StateValuesRegistry.cpp.
+/// </summary>
+template<class StatePolicy = SeparateStates, class DuplicatePolicy = IgnoreDuplicates>
+class BasicStateValuesRegistry
+{
+public:
+	static constexpr uint32_t NoState = UINT32_MAX;
+
+public:
+	BasicStateValuesRegistry();
+	~BasicStateValuesRegistry();
+
 protected:
-	StateValuesRegistry(Participant** participants, unsigned short participantCount, bool isInput);
-	void InitRegistry(Participant** participants, unsigned short participantCount, bool isInput);
-	~StateValuesRegistry();
-	static StateValuesRegistry* s_instance;
+	/// <summary>
+	/// Lays out the participants of the first frame in the process image
+	/// </summary>
+	void InitRegistry(std::span<const Change> changes, bool isInput);
+
+	/// <summary>
+	/// Copies the bytes into the current image and updates its hash
+	/// by replacing the hash of the participant
+	/// </summary>
+	static void ChangeValues(Registry& registry, const Change& change);
+
+	static uint64_t HashParticipant(uint16_t idx, const unsigned char* bytes, unsigned int byteCount);
+
+	/// <summary>
+	/// Looks up the current image with its rolling hash
+	/// </summary>
+	static std::pair<uint32_t, bool> InternCurrentImage(Registry& registry);
 
-	std::vector<participant_ptr_t> FindCurrentValues(bool isInput);
+	uint32_t FindCurrentValues(bool isInput);
+
+	uint32_t FindCombinedValues() requires StatePolicy::IsCombined;
+
+	void AppendValues(std::string& outString, const Registry& registry, const unsigned char* image, bool isInput) const;
+
+	template<class Layout, class, class>
+	friend class FixedLayoutRegistry;
 
 public:
-	StateValuesRegistry(StateValuesRegistry& other) = delete;
-	void operator=(const StateValuesRegistry&) = delete;
-
-	static std::vector<participant_ptr_t> GetStateValues(bool isInput, const std::vector<Change>& changes);
-	
-#ifdef COUNT_DUPLICATES
-	static unsigned int GetNumberOfDuplicates();
-	static std::size_t GetUniqueInputStates();
-	static std::size_t GetUniqueOutputStates();
-#endif
-	
-	static unsigned short GetInputParticipantCount();
-	static unsigned short GetOutputParticipantCount();
+	BasicStateValuesRegistry(BasicStateValuesRegistry& other) = delete;
+	void operator=(const BasicStateValuesRegistry&) = delete;
+
+	/// <summary>
+	/// Applies the changes and returns the id of the resulting state values
+	/// </summary>
+	/// <returns>The state value id or NoState, if the values are not complete yet</returns>
+	uint32_t GetStateValues(bool isInput, std::span<const Change> changes);
+
+	bool IsInputState(uint32_t stateValueId) const;
+
+	bool IsInitialized(bool isInput) const;
+
+	/// <summary>
+	/// Continues a log in its middle. The direction is laid out by its first frame,
+	/// the current values are the last values of all participants before the continued part.
+	/// </summary>
+	void Resume(bool isInput, std::span<const Change> firstChanges, std::span<const Change> currentValues);
+
+	/// <summary>
+	/// Appends the state values of a registry, that continued this one with Resume.
+	/// The images are interned in the order they appeared in the shard.
+	/// </summary>
+	/// <returns>The state value id in this registry of every state value id of the shard</returns>
+	std::vector<uint32_t> Merge(const BasicStateValuesRegistry& shard);
+
+	/// <summary>
+	/// Prints every participant of the state values in a new line
+	/// </summary>
+	std::string PrintStateValues(uint32_t stateValueId) const;
+
+	/// <summary>
+	/// The process image of the state values, all participants back to back in the order of their negated id
+	/// </summary>
+	std::span<const unsigned char> GetStateImage(uint32_t stateValueId) const requires (!StatePolicy::IsCombined);
+
+	/// <summary>
+	/// Counts a frame, that resolved to the state value
+	/// </summary>
+	void RecordHit(uint32_t stateValueId, const uint64_t& timestamp) requires DuplicatePolicy::IsCounted;
+
+	/// <summary>
+	/// The hits of every state value, indexed by the state value id
+	/// </summary>
+	const std::vector<StateHits>& GetStateHits() const requires DuplicatePolicy::IsCounted;
+
+	/// <summary>
+	/// The state values with the most hits in descending order, ties ordered by id.
+	/// Selected in linear time, only the returned ids are sorted.
+	/// </summary>
+	std::vector<uint32_t> GetMostFrequentStates(std::size_t count) const requires DuplicatePolicy::IsCounted;
+
+	unsigned int GetNumberOfDuplicates() const requires DuplicatePolicy::IsCounted;
+	std::size_t GetUniqueInputStates() const requires DuplicatePolicy::IsCounted;
+	std::size_t GetUniqueOutputStates() const requires DuplicatePolicy::IsCounted;
+
+	uint32_t GetInputParticipantCount() const;
+	uint32_t GetOutputParticipantCount() const;
+
+	/// <summary>
+	/// Memory of the images of both directions and the state values
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+	/// <summary>
+	/// Memory changed by resolving frames, without the hits.
+	/// Pipelined ingestion reads it on the resolving thread, while another thread records the hits.
+	/// </summary>
+	std::size_t GetImageByteCount() const;
+
+	/// <summary>
+	/// Memory of the hits, only changed by RecordHit
+	/// </summary>
+	std::size_t GetHitByteCount() const;
 
 protected:
+	struct StateImage
+	{
+		bool isInput;
+		uint32_t imageId;
+	};
+
 	Registry m_inputRegistry;
 	Registry m_outputRegistry;
-#ifdef COUNT_DUPLICATES
-	unsigned int m_duplicateStates;
-#endif
-};
\ No newline at end of file
+	// The pair of input and output image ids, only used by combined states
+	ProcessImageTable m_combinedImages;
+	std::vector<StateImage> m_stateImages;
+	unsigned int m_duplicateStates = 0;
+	// Only used by CountDuplicates
+	std::vector<StateHits> m_stateHits;
+};
+
+using StateValuesRegistry = BasicStateValuesRegistry<>;
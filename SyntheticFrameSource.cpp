@@ -0,0 +1,264 @@
+#include "SyntheticFrameSource.h"
+#include "ImageKernels.h"
+#include "ProcessImageTable.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+
+namespace
+{
+	// Distinguishes the bytes of the inputs and the outputs of a step
+	constexpr uint64_t InputSalt = 0x5851F42D4C957F2DULL;
+	constexpr uint64_t OutputSalt = 0x14057B7EF767814FULL;
+
+	void FillImage(unsigned char* image, std::size_t size, uint32_t step, uint64_t salt)
+	{
+		for (std::size_t i = 0; i < size; ++i)
+			image[i] = static_cast<unsigned char>(ImageKernels::Mix(salt ^ (static_cast<uint64_t>(step) << 32) ^ i));
+
+		// Like the step register of a sequence, which keeps the images of different steps apart
+		for (std::size_t i = 0; i < size && i < sizeof(step); ++i)
+			image[i] = static_cast<unsigned char>(step >> (8 * i));
+	}
+
+	std::vector<Change> LayoutChanges(const std::vector<unsigned int>& byteCounts)
+	{
+		std::vector<Change> changes;
+		for (std::size_t i = 0; i < byteCounts.size(); ++i)
+			changes.push_back({ static_cast<unsigned short>(0 - i), byteCounts[i] });
+		return changes;
+	}
+
+	void PointChanges(std::vector<Change>& changes, const unsigned char* image)
+	{
+		for (auto& change : changes)
+		{
+			change.bytes = image;
+			image += change.byteCount;
+		}
+	}
+}
+
+std::string SyntheticRecovery::Print() const
+{
+	auto percent = [](uint64_t part, uint64_t whole)
+	{
+		return std::to_string(whole == 0 ? 100.0 : 100.0 * part / whole) + "%";
+	};
+
+	return "States: " + std::to_string(recoveredStates) + " of " + std::to_string(truthStates) + " recovered (" + percent(recoveredStates, truthStates) + "), "
+		+ std::to_string(spuriousStates) + " of " + std::to_string(learnedStates) + " learned are spurious\n"
+		+ "Transitions: " + std::to_string(recoveredTransitions) + " of " + std::to_string(truthTransitions) + " recovered (" + percent(recoveredTransitions, truthTransitions) + "), "
+		+ std::to_string(spuriousTransitions) + " of " + std::to_string(learnedTransitions) + " learned are spurious\n";
+}
+
+SyntheticFrameSource::SyntheticFrameSource(uint64_t frameCount, const SyntheticProcess& process)
+	: m_frameCount(frameCount)
+	, m_process(process)
+{
+	if (m_process.cycleLength == 0)
+		m_process.cycleLength = 1;
+
+	m_inputSize = std::accumulate(m_process.inputByteCounts.begin(), m_process.inputByteCounts.end(), std::size_t(0));
+	m_outputSize = std::accumulate(m_process.outputByteCounts.begin(), m_process.outputByteCounts.end(), std::size_t(0));
+
+	auto stepCount = GetStepCount();
+	m_nextSteps.resize(stepCount);
+	for (uint32_t step = 0; step < m_process.cycleLength; ++step)
+		m_nextSteps[step].push_back((step + 1) % m_process.cycleLength);
+
+	std::mt19937_64 random(m_process.seed);
+	for (uint32_t branch = 0; branch < m_process.branchCount; ++branch)
+	{
+		uint32_t from = static_cast<uint32_t>(random() % m_process.cycleLength);
+		uint32_t to = static_cast<uint32_t>(random() % m_process.cycleLength);
+
+		uint32_t step = from;
+		for (uint32_t i = 0; i < m_process.branchLength; ++i)
+		{
+			uint32_t branchStep = m_process.cycleLength + branch * m_process.branchLength + i;
+			m_nextSteps[step].push_back(branchStep);
+			step = branchStep;
+		}
+		m_nextSteps[step].push_back(to);
+	}
+
+	m_inputImages.resize(stepCount * m_inputSize);
+	m_outputImages.resize(stepCount * m_outputSize);
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		FillImage(m_inputImages.data() + step * m_inputSize, m_inputSize, step, m_process.seed ^ InputSalt);
+		FillImage(m_outputImages.data() + step * m_outputSize, m_outputSize, step, m_process.seed ^ OutputSalt);
+	}
+}
+
+SyntheticFrameSource::SyntheticFrameSource(uint64_t frameCount, uint16_t participantCount /*= 4*/, uint32_t cycleLength /*= 16*/, double glitchRate /*= 0.01*/, uint64_t seed /*= 0*/)
+	: SyntheticFrameSource(frameCount, SyntheticProcess{
+		std::vector<unsigned int>(participantCount, 2),
+		std::vector<unsigned int>(participantCount, 2),
+		cycleLength, 0, 4, 0.1, glitchRate, 1000, 100, 100, seed })
+{
+}
+
+bool SyntheticFrameSource::ReadFrames(const BatchCallback& onBatch)
+{
+	std::mt19937_64 random(m_process.seed);
+	std::uniform_int_distribution<uint64_t> jitter(0, m_process.stepJitter);
+	std::bernoulli_distribution glitch(m_process.glitchRate);
+	std::bernoulli_distribution takeBranch(m_process.branchRate);
+
+	FrameBatch batch;
+	auto inputChanges = LayoutChanges(m_process.inputByteCounts);
+	auto outputChanges = LayoutChanges(m_process.outputByteCounts);
+	std::vector<unsigned char> glitchImage(m_inputSize);
+
+	uint64_t timestamp = 0;
+	uint32_t step = 0;
+
+	for (uint64_t frame = 0; frame < m_frameCount; ++frame)
+	{
+		// Outputs start a step, the inputs acknowledge it
+		bool isInput = frame % 2 == 1;
+
+		if (isInput)
+		{
+			auto image = GetImage(step, true);
+			if (m_inputSize != 0 && glitch(random))
+			{
+				// A single byte differs from the acknowledgement
+				std::copy(image, image + m_inputSize, glitchImage.begin());
+				glitchImage[random() % m_inputSize] ^= static_cast<unsigned char>(1 + random() % 255);
+				image = glitchImage.data();
+			}
+
+			PointChanges(inputChanges, image);
+			batch.Append(timestamp, true, inputChanges);
+		}
+		else
+		{
+			PointChanges(outputChanges, GetImage(step, false));
+			batch.Append(timestamp, false, outputChanges);
+		}
+
+		if (batch.IsFull())
+		{
+			onBatch(batch.Complete());
+			batch.Clear();
+		}
+
+		timestamp += isInput ? m_process.stepTime + jitter(random) : m_process.acknowledgeTime;
+
+		if (isInput)
+		{
+			auto& nextSteps = m_nextSteps[step];
+			if (nextSteps.size() > 1 && takeBranch(random))
+				step = nextSteps[1 + random() % (nextSteps.size() - 1)];
+			else
+				step = nextSteps.front();
+		}
+	}
+
+	if (batch.GetFrameCount() != 0)
+		onBatch(batch.Complete());
+
+	return true;
+}
+
+const SyntheticProcess& SyntheticFrameSource::GetProcess() const
+{
+	return m_process;
+}
+
+uint32_t SyntheticFrameSource::GetStepCount() const
+{
+	return m_process.cycleLength + m_process.branchCount * m_process.branchLength;
+}
+
+const unsigned char* SyntheticFrameSource::GetImage(uint32_t step, bool isInput) const
+{
+	return isInput ? m_inputImages.data() + step * m_inputSize : m_outputImages.data() + step * m_outputSize;
+}
+
+SyntheticRecovery SyntheticFrameSource::Compare(const FiniteStateMachine& fsm) const
+{
+	SyntheticRecovery recovery;
+
+	// The ground truth states are interned first, so every later id is outside of it
+	ProcessImageTable outputImages(m_outputSize);
+	ProcessImageTable inputImages(m_inputSize);
+	auto stepCount = GetStepCount();
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		outputImages.Intern(GetImage(step, false));
+		inputImages.Intern(GetImage(step, true));
+	}
+
+	auto truthOutputs = static_cast<uint32_t>(outputImages.GetImageCount());
+	auto truthInputs = static_cast<uint32_t>(inputImages.GetImageCount());
+	recovery.truthStates = truthOutputs + truthInputs;
+
+	// A truth state is the image id, the inputs follow the outputs
+	auto truthState = [&](uint32_t step, bool isInput)
+	{
+		return isInput
+			? truthOutputs + inputImages.Intern(GetImage(step, true)).first
+			: outputImages.Intern(GetImage(step, false)).first;
+	};
+	auto transitionKey = [](uint64_t source, uint64_t target) { return source << 32 | target; };
+
+	std::unordered_set<uint64_t> truthTransitions;
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		truthTransitions.insert(transitionKey(truthState(step, false), truthState(step, true)));
+		for (auto nextStep : m_nextSteps[step])
+			truthTransitions.insert(transitionKey(truthState(step, true), truthState(nextStep, false)));
+	}
+	recovery.truthTransitions = truthTransitions.size();
+
+	auto& graph = fsm.GetGraph();
+	auto& registry = fsm.GetRegistry();
+
+	std::vector<uint32_t> truthStates(graph.GetStateCount(), StateGraph::NoState);
+	std::vector<bool> isRecovered(recovery.truthStates, false);
+	for (uint32_t state = 0; state < graph.GetStateCount(); ++state)
+	{
+		auto valueId = graph.GetState(state).valueId;
+		bool isInput = registry.IsInputState(valueId);
+		auto image = registry.GetStateImage(valueId);
+		auto& images = isInput ? inputImages : outputImages;
+
+		if (image.size() == images.GetImageSize())
+		{
+			auto imageId = images.Intern(image.data()).first;
+			if (imageId < (isInput ? truthInputs : truthOutputs))
+				truthStates[state] = isInput ? truthOutputs + imageId : imageId;
+		}
+
+		if (truthStates[state] == StateGraph::NoState)
+			++recovery.spuriousStates;
+		else
+			isRecovered[truthStates[state]] = true;
+	}
+	recovery.learnedStates = graph.GetStateCount();
+	recovery.recoveredStates = std::count(isRecovered.begin(), isRecovered.end(), true);
+
+	std::unordered_set<uint64_t> recoveredTransitions;
+	for (uint32_t state = 0; state < graph.GetStateCount(); ++state)
+	{
+		for (auto transition = graph.TransitionsBegin(state); transition != graph.TransitionsEnd(state); ++transition)
+		{
+			auto source = truthStates[state];
+			auto target = truthStates[graph.GetTarget(transition)];
+
+			if (source != StateGraph::NoState && target != StateGraph::NoState && truthTransitions.count(transitionKey(source, target)))
+				recoveredTransitions.insert(transitionKey(source, target));
+			else
+				++recovery.spuriousTransitions;
+		}
+	}
+	recovery.learnedTransitions = graph.GetTransitionCount();
+	recovery.recoveredTransitions = recoveredTransitions.size();
+
+	return recovery;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "FrameSource.h"
+#include "FiniteStateMachine.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Ground truth of a synthetic PLC process. Every step sets the outputs of all participants and is acknowledged by their inputs.
+/// The steps form a main cycle, branches leave it at a random step and rejoin it at another one.
+/// </summary>
+struct SyntheticProcess
+{
+	// Bytes of every participant, participant i has the id -i. The first bytes hold the number of the step.
+	std::vector<unsigned int> inputByteCounts = { 2, 2, 2, 2 };
+	std::vector<unsigned int> outputByteCounts = { 2, 2, 2, 2 };
+	// Steps until the process repeats
+	uint32_t cycleLength = 16;
+	// Alternative paths of branchLength steps
+	uint32_t branchCount = 0;
+	uint32_t branchLength = 4;
+	// Probability to take one of the branches at the step they leave from
+	double branchRate = 0.1;
+	// Probability of an input glitch per step, a glitch adds a state outside of the ground truth
+	double glitchRate = 0.01;
+	// Microseconds from the inputs of one step to the outputs of the next, with a jitter of up to stepJitter
+	uint64_t stepTime = 1000;
+	uint64_t stepJitter = 100;
+	// Microseconds until the inputs acknowledge a step
+	uint64_t acknowledgeTime = 100;
+	uint64_t seed = 0;
+};
+
+/// <summary>
+/// How closely a learned machine recovers the ground truth of a synthetic process
+/// </summary>
+struct SyntheticRecovery
+{
+	uint64_t truthStates = 0;
+	uint64_t learnedStates = 0;
+	// States of the ground truth, that were learned
+	uint64_t recoveredStates = 0;
+	// Learned states outside of the ground truth, e.g. glitches
+	uint64_t spuriousStates = 0;
+
+	uint64_t truthTransitions = 0;
+	uint64_t learnedTransitions = 0;
+	uint64_t recoveredTransitions = 0;
+	uint64_t spuriousTransitions = 0;
+
+	std::string Print() const;
+};
+
+/// <summary>
+/// Generates the frames of a synthetic PLC process without a log file.
+/// The frames are generated while they are read, so the number of frames is not bound by the memory.
+/// The frames only depend on the process, so equal seeds give equal machines.
+/// </summary>
+class SyntheticFrameSource : public FrameSource
+{
+public:
+	SyntheticFrameSource(uint64_t frameCount, const SyntheticProcess& process);
+
+	/// <param name="frameCount">Number of frames, input and output frames alternate</param>
+	/// <param name="participantCount">Participants in both directions, every one with 2 bytes</param>
+	/// <param name="cycleLength">Steps until the process repeats</param>
+	/// <param name="glitchRate">Probability of an input glitch per step</param>
+	SyntheticFrameSource(uint64_t frameCount, uint16_t participantCount = 4, uint32_t cycleLength = 16, double glitchRate = 0.01, uint64_t seed = 0);
+
+	bool ReadFrames(const BatchCallback& onBatch) override;
+
+	const SyntheticProcess& GetProcess() const;
+
+	/// <summary>
+	/// Steps of the main cycle and of all branches
+	/// </summary>
+	uint32_t GetStepCount() const;
+
+	/// <summary>
+	/// Compares the states and transitions of a machine, as it was learned from this source, with the ground truth.
+	/// Every step is one output state and one input state, the transitions lead from the outputs to their
+	/// inputs and from the inputs to the outputs of every possible next step.
+	/// </summary>
+	SyntheticRecovery Compare(const FiniteStateMachine& fsm) const;
+
+private:
+	const unsigned char* GetImage(uint32_t step, bool isInput) const;
+
+private:
+	uint64_t m_frameCount;
+	SyntheticProcess m_process;
+	std::size_t m_inputSize = 0;
+	std::size_t m_outputSize = 0;
+	// The images of all steps back to back
+	std::vector<unsigned char> m_inputImages;
+	std::vector<unsigned char> m_outputImages;
+	// The next step of the main cycle comes first, followed by the branches leaving the step
+	std::vector<std::vector<uint32_t>> m_nextSteps;
+};
@@ -0,0 +1,50 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount /*= 0*/)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	m_threads.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_threads.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_condition.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return static_cast<unsigned int>(m_threads.size());
+}
+
+void ThreadPool::Work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_isStopping || !m_tasks.empty(); });
+
+			// The queue is drained before the workers stop
+			if (m_tasks.empty())
+				return;
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// <summary>
+/// Fixed number of worker threads running the submitted tasks in order
+/// </summary>
+class ThreadPool
+{
+public:
+	/// <summary>
+	/// Starts the workers, 0 uses one per hardware thread
+	/// </summary>
+	explicit ThreadPool(unsigned int threadCount = 0);
+
+	/// <summary>
+	/// Finishes all submitted tasks and joins the workers
+	/// </summary>
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+public:
+	/// <summary>
+	/// Queues the function, the future returns its result or rethrows its exception
+	/// </summary>
+	template<typename Function>
+	std::future<std::invoke_result_t<Function>> Submit(Function&& function)
+	{
+		using Result = std::invoke_result_t<Function>;
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+		auto future = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.emplace([task]() { (*task)(); });
+		}
+		m_condition.notify_one();
+
+		return future;
+	}
+
+	unsigned int GetThreadCount() const;
+
+private:
+	void Work();
+
+private:
+	std::vector<std::thread> m_threads;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_isStopping = false;
+};
@@ -0,0 +1,213 @@
+#include "TimestampColumn.h"
+#include <algorithm>
+
+void InsertTimestamp(TimestampVector& timestamps, uint64_t timestamp)
+{
+	// The frames of a log arrive in order
+	if (timestamps.empty() || timestamps.back() < timestamp)
+	{
+		timestamps.push_back(timestamp);
+		return;
+	}
+
+	auto it = std::lower_bound(timestamps.begin(), timestamps.end(), timestamp);
+	if (*it != timestamp)
+		timestamps.insert(it, timestamp);
+}
+
+void MergeTimestamps(TimestampVector& timestamps, const TimestampVector& other)
+{
+	if (other.empty())
+		return;
+
+	if (timestamps.empty() || timestamps.back() < other.front())
+	{
+		timestamps.insert(timestamps.end(), other.begin(), other.end());
+		return;
+	}
+
+	// The vectors may come from different pools, so the result uses the pool of the first one
+	TimestampVector merged(timestamps.get_allocator());
+	merged.reserve(timestamps.size() + other.size());
+	std::set_union(timestamps.begin(), timestamps.end(), other.begin(), other.end(), std::back_inserter(merged));
+	timestamps.swap(merged);
+}
+
+TransitionTimes::TransitionTimes(const allocator_type& allocator /*= {}*/)
+	: timestamps(allocator)
+{
+}
+
+TransitionTimes::TransitionTimes(const TransitionTimes& other, const allocator_type& allocator /*= {}*/)
+	: timestamps(other.timestamps, allocator)
+	, statistics(other.statistics)
+{
+}
+
+TransitionTimes::TransitionTimes(TransitionTimes&& other, const allocator_type& allocator)
+	: timestamps(std::move(other.timestamps), allocator)
+	, statistics(std::move(other.statistics))
+{
+}
+
+void InsertTimestamp(TransitionTimes& times, uint64_t timestamp, uint64_t duration)
+{
+	InsertTimestamp(times.timestamps, timestamp);
+	times.statistics.Add(duration);
+}
+
+void MergeTimestamps(TransitionTimes& times, const TransitionTimes& other)
+{
+	// Every step belongs to one transition, so both statistics summarize disjoint steps
+	times.statistics.Merge(other.statistics);
+	MergeTimestamps(times.timestamps, other.timestamps);
+}
+
+void RetainTimestamps(TimestampVector& timestamps, std::size_t count, uint64_t oldest)
+{
+	auto first = std::lower_bound(timestamps.begin(), timestamps.end(), oldest);
+	if (static_cast<std::size_t>(timestamps.end() - first) > count)
+		first = timestamps.end() - count;
+
+	timestamps.erase(timestamps.begin(), first);
+}
+
+TimestampRange::Iterator::Iterator(const unsigned char* bytes, uint32_t remaining)
+	: m_bytes(bytes)
+	, m_remaining(remaining)
+{
+	if (m_remaining != 0)
+		Decode();
+}
+
+TimestampRange::Iterator& TimestampRange::Iterator::operator++()
+{
+	if (--m_remaining != 0)
+		Decode();
+	return *this;
+}
+
+TimestampRange::Iterator TimestampRange::Iterator::operator++(int)
+{
+	auto copy = *this;
+	++*this;
+	return copy;
+}
+
+void TimestampRange::Iterator::Decode()
+{
+	uint64_t delta = 0;
+	unsigned int shift = 0;
+	unsigned char byte;
+	do {
+		byte = *m_bytes++;
+		delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+
+	m_value += delta;
+}
+
+TimestampRange::TimestampRange(const unsigned char* bytes, uint32_t count)
+	: m_bytes(bytes)
+	, m_count(count)
+{
+}
+
+TimestampRange::Iterator TimestampRange::begin() const
+{
+	return Iterator(m_bytes, m_count);
+}
+
+TimestampRange::Iterator TimestampRange::end() const
+{
+	return Iterator();
+}
+
+uint32_t TimestampRange::size() const
+{
+	return m_count;
+}
+
+bool TimestampRange::empty() const
+{
+	return m_count == 0;
+}
+
+uint64_t TimestampRange::front() const
+{
+	return *begin();
+}
+
+uint64_t TimestampRange::back() const
+{
+	uint64_t last = 0;
+	for (auto timestamp : *this)
+		last = timestamp;
+	return last;
+}
+
+TimestampVector TimestampRange::Decode() const
+{
+	TimestampVector timestamps;
+	timestamps.reserve(m_count);
+	timestamps.assign(begin(), end());
+	return timestamps;
+}
+
+uint32_t TimestampColumn::Append(const TimestampVector& timestamps)
+{
+	uint64_t previous = 0;
+	for (auto timestamp : timestamps)
+	{
+		uint64_t delta = timestamp - previous;
+		previous = timestamp;
+
+		while (delta >= 0x80)
+		{
+			m_bytes.push_back(static_cast<unsigned char>(delta | 0x80));
+			delta >>= 7;
+		}
+		m_bytes.push_back(static_cast<unsigned char>(delta));
+	}
+
+	m_offsets.push_back(m_bytes.size());
+	m_counts.push_back(static_cast<uint32_t>(timestamps.size()));
+	m_timestampCount += timestamps.size();
+
+	return static_cast<uint32_t>(m_counts.size() - 1);
+}
+
+TimestampRange TimestampColumn::Get(uint32_t list) const
+{
+	return TimestampRange(m_bytes.data() + m_offsets[list], m_counts[list]);
+}
+
+uint32_t TimestampColumn::GetListCount() const
+{
+	return static_cast<uint32_t>(m_counts.size());
+}
+
+uint64_t TimestampColumn::GetTimestampCount() const
+{
+	return m_timestampCount;
+}
+
+std::size_t TimestampColumn::GetByteCount() const
+{
+	return m_bytes.capacity()
+		+ m_offsets.capacity() * sizeof(uint64_t)
+		+ m_counts.capacity() * sizeof(uint32_t);
+}
+
+void TimestampColumn::ShrinkToFit()
+{
+	m_bytes.shrink_to_fit();
+	m_offsets.shrink_to_fit();
+	m_counts.shrink_to_fit();
+}
+
+void TimestampColumn::Clear()
+{
+	*this = TimestampColumn();
+}
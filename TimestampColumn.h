@@ -0,0 +1,184 @@
+#pragma once
+#include "TimingStatistics.h"
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <memory_resource>
+#include <vector>
+
+/// <summary>
+/// Sorted timestamps without duplicates, used while the graph is mutable.
+/// Inside the graph builder they are allocated from its pool.
+/// </summary>
+using TimestampVector = std::pmr::vector<uint64_t>;
+
+/// <summary>
+/// Inserts the timestamp at its sorted position, appending is the fast path
+/// </summary>
+void InsertTimestamp(TimestampVector& timestamps, uint64_t timestamp);
+
+/// <summary>
+/// Linear merge of two sorted vectors into the first one
+/// </summary>
+void MergeTimestamps(TimestampVector& timestamps, const TimestampVector& other);
+
+/// <summary>
+/// The times of one transition while the graph is mutable, with the streaming statistics of its durations.
+/// The timestamps are the times the run took the transition, the durations the times since the run entered its source.
+/// Allocator aware, so inside the transition maps the timestamps stay in the pool of the builder.
+/// </summary>
+struct TransitionTimes
+{
+	using allocator_type = std::pmr::polymorphic_allocator<uint64_t>;
+
+	TransitionTimes(const allocator_type& allocator = {});
+	TransitionTimes(const TransitionTimes& other, const allocator_type& allocator = {});
+	TransitionTimes(TransitionTimes&& other) noexcept = default;
+	TransitionTimes(TransitionTimes&& other, const allocator_type& allocator);
+
+	TransitionTimes& operator=(const TransitionTimes& other) = default;
+	TransitionTimes& operator=(TransitionTimes&& other) = default;
+
+	TimestampVector timestamps;
+	TimingStatistics statistics;
+};
+
+/// <summary>
+/// Inserts the timestamp of one step of the run and adds its duration to the statistics
+/// </summary>
+void InsertTimestamp(TransitionTimes& times, uint64_t timestamp, uint64_t duration);
+
+/// <summary>
+/// Merges the timestamps and the statistics of the steps of both transitions
+/// </summary>
+void MergeTimestamps(TransitionTimes& times, const TransitionTimes& other);
+
+/// <summary>
+/// Which timestamps the transitions keep, the statistics of a transition always cover all of its steps.
+/// Above the memory budget the transitions keep fewer timestamps, down to only their statistics.
+/// The states and transitions themselves are never dropped.
+/// </summary>
+struct TimestampRetention
+{
+	enum class Mode
+	{
+		All,
+		// The last count timestamps of every transition
+		LastCount,
+		// The timestamps within window microseconds before the latest frame
+		TimeWindow,
+		SummaryOnly
+	};
+
+	Mode mode = Mode::All;
+	std::size_t count = 0;
+	uint64_t window = 0;
+	// Bytes of the whole machine, 0 for no budget
+	std::size_t memoryBudget = 0;
+};
+
+/// <summary>
+/// Erases the timestamps before the oldest one kept and all but the last count
+/// </summary>
+void RetainTimestamps(TimestampVector& timestamps, std::size_t count, uint64_t oldest);
+
+/// <summary>
+/// View of the encoded timestamps of one transition
+/// </summary>
+class TimestampRange
+{
+public:
+	/// <summary>
+	/// Decodes one delta after another
+	/// </summary>
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = uint64_t;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const uint64_t*;
+		using reference = const uint64_t&;
+
+	public:
+		Iterator() = default;
+		Iterator(const unsigned char* bytes, uint32_t remaining);
+
+		reference operator*() const { return m_value; }
+		pointer operator->() const { return &m_value; }
+
+		Iterator& operator++();
+		Iterator operator++(int);
+
+		bool operator==(const Iterator& other) const { return m_remaining == other.m_remaining; }
+		bool operator!=(const Iterator& other) const { return m_remaining != other.m_remaining; }
+
+	private:
+		void Decode();
+
+	private:
+		const unsigned char* m_bytes = nullptr;
+		uint32_t m_remaining = 0;
+		uint64_t m_value = 0;
+	};
+
+public:
+	TimestampRange(const unsigned char* bytes, uint32_t count);
+
+	Iterator begin() const;
+	Iterator end() const;
+
+	uint32_t size() const;
+	bool empty() const;
+
+	uint64_t front() const;
+	/// <summary>
+	/// Decodes the whole range
+	/// </summary>
+	uint64_t back() const;
+
+	TimestampVector Decode() const;
+
+private:
+	const unsigned char* m_bytes;
+	uint32_t m_count;
+};
+
+/// <summary>
+/// The timestamps of all transitions in one buffer.
+/// Every list is stored as the differences to its previous timestamp, as LEB128 varints.
+/// </summary>
+class TimestampColumn
+{
+public:
+	/// <summary>
+	/// Encodes the sorted timestamps as the next list
+	/// </summary>
+	/// <returns>The number of the list</returns>
+	uint32_t Append(const TimestampVector& timestamps);
+
+	TimestampRange Get(uint32_t list) const;
+
+	uint32_t GetListCount() const;
+
+	uint64_t GetTimestampCount() const;
+
+	/// <summary>
+	/// Memory of the encoded timestamps and the list offsets
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+	/// <summary>
+	/// Releases the spare capacity, once all lists are appended
+	/// </summary>
+	void ShrinkToFit();
+
+	void Clear();
+
+private:
+	std::vector<unsigned char> m_bytes;
+	// Start of every list in the bytes, one more for the end
+	std::vector<uint64_t> m_offsets = { 0 };
+	std::vector<uint32_t> m_counts;
+	uint64_t m_timestampCount = 0;
+};
@@ -0,0 +1,218 @@
+#include "TimingStatistics.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	// Neighbouring buckets differ by the factor gamma, so every value is within the accuracy of its bucket
+	const double Gamma = (1 + TimingStatistics::RelativeAccuracy) / (1 - TimingStatistics::RelativeAccuracy);
+	const double LogGamma = std::log(Gamma);
+
+	int32_t GetBucket(uint64_t value)
+	{
+		return static_cast<int32_t>(std::ceil(std::log(static_cast<double>(value)) / LogGamma));
+	}
+
+	// The value with the same relative error to both bounds of the bucket
+	double GetBucketValue(int32_t bucket)
+	{
+		return 2 * std::pow(Gamma, bucket) / (Gamma + 1);
+	}
+}
+
+void TimingStatistics::Add(uint64_t value)
+{
+	++m_count;
+	m_sum += value;
+	m_min = std::min(m_min, value);
+	m_max = std::max(m_max, value);
+
+	double delta = value - m_mean;
+	m_mean += delta / m_count;
+	m_m2 += delta * (value - m_mean);
+
+	if (value == 0)
+		++m_zeroCount;
+	else
+		AddToBucket(GetBucket(value), 1);
+}
+
+void TimingStatistics::Merge(const TimingStatistics& other)
+{
+	if (other.m_count == 0)
+		return;
+
+	if (m_count == 0)
+	{
+		*this = other;
+		return;
+	}
+
+	// Chan's parallel update of the mean and the squared deviations
+	double count = static_cast<double>(m_count + other.m_count);
+	double delta = other.m_mean - m_mean;
+	m_mean += delta * other.m_count / count;
+	m_m2 += other.m_m2 + delta * delta * m_count * other.m_count / count;
+
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+
+	// Ascending, so the buckets grow downwards at most once
+	m_zeroCount += other.m_zeroCount;
+	for (std::size_t i = 0; i < other.m_buckets.size(); ++i)
+		if (other.m_buckets[i] != 0)
+			AddToBucket(other.m_firstBucket + static_cast<int32_t>(i), other.m_buckets[i]);
+}
+
+void TimingStatistics::Shift(uint64_t offset)
+{
+	if (m_count == 0 || offset == 0)
+		return;
+
+	m_sum += offset * m_count;
+	m_min += offset;
+	m_max += offset;
+	m_mean += offset;
+
+	// The value of every bucket moves into the bucket of the shifted value
+	auto zeroCount = m_zeroCount;
+	auto firstBucket = m_firstBucket;
+	auto buckets = std::move(m_buckets);
+	m_zeroCount = 0;
+	m_buckets.clear();
+
+	if (zeroCount != 0)
+		AddToBucket(GetBucket(offset), zeroCount);
+	for (std::size_t i = 0; i < buckets.size(); ++i)
+		if (buckets[i] != 0)
+			AddToBucket(GetBucket(static_cast<uint64_t>(std::llround(GetBucketValue(firstBucket + static_cast<int32_t>(i)))) + offset), buckets[i]);
+}
+
+void TimingStatistics::Clear()
+{
+	*this = TimingStatistics();
+}
+
+uint64_t TimingStatistics::GetCount() const
+{
+	return m_count;
+}
+
+uint64_t TimingStatistics::GetMin() const
+{
+	return m_count == 0 ? 0 : m_min;
+}
+
+uint64_t TimingStatistics::GetMax() const
+{
+	return m_max;
+}
+
+uint64_t TimingStatistics::GetSum() const
+{
+	return m_sum;
+}
+
+double TimingStatistics::GetMean() const
+{
+	return m_count == 0 ? 0 : (double)m_sum / (double)m_count;
+}
+
+double TimingStatistics::GetVariance() const
+{
+	return m_count == 0 ? 0 : m_m2 / m_count;
+}
+
+double TimingStatistics::GetStandardDeviation() const
+{
+	return std::sqrt(GetVariance());
+}
+
+double TimingStatistics::GetQuantile(double quantile) const
+{
+	if (m_count == 0)
+		return 0;
+	if (quantile <= 0)
+		return static_cast<double>(m_min);
+	if (quantile >= 1)
+		return static_cast<double>(m_max);
+
+	double rank = quantile * (m_count - 1);
+	uint64_t seen = m_zeroCount;
+	double value = 0;
+
+	if (rank >= seen)
+	{
+		for (std::size_t i = 0; i < m_buckets.size(); ++i)
+		{
+			seen += m_buckets[i];
+			if (rank < seen)
+			{
+				value = GetBucketValue(m_firstBucket + static_cast<int32_t>(i));
+				break;
+			}
+		}
+	}
+
+	return std::clamp(value, static_cast<double>(m_min), static_cast<double>(m_max));
+}
+
+double TimingStatistics::GetSpread() const
+{
+	// Relative to a minimum of 0 the spread has no bound
+	if (m_count == 0 || m_min == 0)
+		return 0;
+
+	double mean = GetMean();
+	double minFraction = mean / m_min - 1.0;
+	double maxFraction = m_max / mean - 1.0;
+	return std::max(minFraction, maxFraction);
+}
+
+std::size_t TimingStatistics::GetByteCount() const
+{
+	return sizeof(TimingStatistics) + m_buckets.capacity() * sizeof(uint64_t);
+}
+
+void TimingStatistics::AddToBucket(int32_t bucket, uint64_t count)
+{
+	if (m_buckets.empty())
+	{
+		m_firstBucket = bucket;
+		m_buckets.push_back(count);
+		return;
+	}
+
+	auto lastBucket = m_firstBucket + static_cast<int32_t>(m_buckets.size()) - 1;
+
+	if (bucket < m_firstBucket)
+	{
+		// The buckets only grow downwards within the bound, lower values fall into the lowest bucket
+		auto lowestBucket = std::max(bucket, lastBucket - static_cast<int32_t>(MaxBucketCount) + 1);
+		if (lowestBucket < m_firstBucket)
+		{
+			m_buckets.insert(m_buckets.begin(), m_firstBucket - lowestBucket, 0);
+			m_firstBucket = lowestBucket;
+		}
+		bucket = std::max(bucket, m_firstBucket);
+	}
+	else if (bucket > lastBucket)
+	{
+		m_buckets.resize(bucket - m_firstBucket + 1, 0);
+
+		if (m_buckets.size() > MaxBucketCount)
+		{
+			// The lowest buckets are collapsed into the lowest one kept
+			auto excess = m_buckets.size() - MaxBucketCount;
+			auto collapsed = std::accumulate(m_buckets.begin(), m_buckets.begin() + excess, uint64_t(0));
+			m_buckets.erase(m_buckets.begin(), m_buckets.begin() + excess);
+			m_buckets.front() += collapsed;
+			m_firstBucket += static_cast<int32_t>(excess);
+		}
+	}
+
+	m_buckets[bucket - m_firstBucket] += count;
+}
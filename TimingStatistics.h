@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Streaming summary of the durations of one transition. Count, minimum, maximum, mean and variance are exact,
+/// the quantiles come from a sketch of logarithmic buckets (DDSketch), that is accurate to RelativeAccuracy.
+/// Summaries of disjoint sets of times merge into the summary of their union.
+/// </summary>
+class TimingStatistics
+{
+public:
+	// Relative error of every quantile
+	static constexpr double RelativeAccuracy = 0.01;
+	// Bound of the buckets of one sketch, beyond it the lowest buckets are collapsed,
+	// so the upper quantiles stay accurate over a range of more than two decades
+	static constexpr std::size_t MaxBucketCount = 256;
+
+public:
+	void Add(uint64_t value);
+
+	void Merge(const TimingStatistics& other);
+
+	/// <summary>
+	/// Adds the offset to every time, e.g. the time of a step before them. The variance is kept,
+	/// the quantiles stay within RelativeAccuracy as every bucket only moves further from 0.
+	/// </summary>
+	void Shift(uint64_t offset);
+
+	void Clear();
+
+	uint64_t GetCount() const;
+	uint64_t GetMin() const;
+	uint64_t GetMax() const;
+	uint64_t GetSum() const;
+
+	double GetMean() const;
+
+	/// <summary>
+	/// Population variance, updated with Welford's algorithm
+	/// </summary>
+	double GetVariance() const;
+
+	double GetStandardDeviation() const;
+
+	/// <param name="quantile">Between 0 and 1, e.g. 0.95 for P95</param>
+	/// <returns>The quantile within RelativeAccuracy, clamped to the minimum and maximum</returns>
+	double GetQuantile(double quantile) const;
+
+	/// <summary>
+	/// Largest deviation of the minimum or maximum from the mean, relative to the smaller of both.
+	/// 0 without times or with a minimum of 0.
+	/// </summary>
+	double GetSpread() const;
+
+	/// <summary>
+	/// Memory of the summary and its buckets
+	/// </summary>
+	std::size_t GetByteCount() const;
+
+private:
+	void AddToBucket(int32_t bucket, uint64_t count);
+
+private:
+	uint64_t m_count = 0;
+	uint64_t m_min = UINT64_MAX;
+	uint64_t m_max = 0;
+	// The exact mean is taken from the sum, the running mean only serves the variance
+	uint64_t m_sum = 0;
+	double m_mean = 0;
+	double m_m2 = 0;
+
+	// A value v > 0 falls into bucket ceil(log(v) / log(gamma)), the buckets start at m_firstBucket
+	uint64_t m_zeroCount = 0;
+	int32_t m_firstBucket = 0;
+	std::vector<uint64_t> m_buckets;
+};
@@ -1,39 +1,273 @@
 #include "FiniteStateMachine.h"
+#include "BinaryFrameLog.h"
+#include "BatchBuilder.h"
+#include "ImageKernels.h"
+#include "BenchmarkSuite.h"
+#include "SyntheticFrameSource.h"
+#include "Condensation.h"
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
 
-#define UniqueStates
+//#define CONVERT_TO_BINARY
+//#define BUILD_BATCH
+//#define BENCHMARK_INGESTION
+//#define BENCHMARK_KERNELS
+//#define BENCHMARK_LAYOUT
+//#define BENCHMARK_SUITE
+//#define GENERATE_SYNTHETIC
+//#define CHECK_CORRUPT_LOG
 
-int main()
+#ifdef BENCHMARK_SUITE
+// The heap of the whole binary is counted, so the suite can report the allocations of every benchmark
+void* operator new(std::size_t byteCount) { return BenchmarkSuite::Allocate(byteCount); }
+void* operator new[](std::size_t byteCount) { return BenchmarkSuite::Allocate(byteCount); }
+void operator delete(void* pointer) noexcept { BenchmarkSuite::Free(pointer); }
+void operator delete[](void* pointer) noexcept { BenchmarkSuite::Free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { BenchmarkSuite::Free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { BenchmarkSuite::Free(pointer); }
+#endif
+
+/// <summary>
+/// Builds the machine of the log and writes its automaton, every mode is a separate instantiation
+/// </summary>
+template<class StatePolicy, class DuplicatePolicy>
+void Analyze(const std::string& filePath, bool uniqueStates)
 {
-    FSM fsm("TAreal.json");
+    BasicFiniteStateMachine<StatePolicy, DuplicatePolicy> fsm(filePath);
 
     //std::cout << "Total Number of States: " << fsm.GetStateCount() << std::endl;
 
-#ifdef COUNT_DUPLICATES
-    std::cout << "Duplicates: " << StateValuesRegistry::GetNumberOfDuplicates() << std::endl;
-    std::cout << "Unique Input States: " << StateValuesRegistry::GetUniqueInputStates()
-        << ", Unique Output States: " << StateValuesRegistry::GetUniqueOutputStates() << std::endl;
-#endif
+    if constexpr (DuplicatePolicy::IsCounted)
+    {
+        std::cout << "Duplicates: " << fsm.GetRegistry().GetNumberOfDuplicates() << std::endl;
+        std::cout << "Unique Input States: " << fsm.GetRegistry().GetUniqueInputStates()
+            << ", Unique Output States: " << fsm.GetRegistry().GetUniqueOutputStates() << std::endl;
+
+        std::ofstream duplicatesFile("Duplicates.txt");
+        duplicatesFile << fsm.PrintDuplicates(10);
+        duplicatesFile.close();
+    }
     
-#ifdef UniqueStates
-	std::cout << "Linear Combine combined " << std::to_string(fsm.CombineSequences()) << " states.";
-	std::cout << " => New Total Number of States: " << fsm.GetStateCount() << std::endl;
-	//std::cout << fsm.CombineSCC() << " states were part of any circuit." << std::endl;
+    if (!uniqueStates)
+        return;
+
+    std::cout << "Linear Combine combined " << std::to_string(fsm.CombineSequences()) << " states.";
+    std::cout << " => New Total Number of States: " << fsm.GetStateCount() << std::endl;
+    //std::cout << Condensation(fsm.GetGraph()).GetComponentCount() << " strongly connected components." << std::endl;
+    //std::cout << fsm.CombineSCC() << " states were part of any circuit." << std::endl;
     
-	fsm.RenumberStates();
-	//fsm.RemoveInputStates();
+    fsm.RenumberStates();
+    //if constexpr (!StatePolicy::IsCombined) fsm.RemoveInputStates();
     //fsm.RelativeTimes();
 
-	//uint64_t taboo = 75;
-	//fsm.CutToPart(40, 71, true, &taboo);
+    //uint64_t taboo = 75;
+    //fsm.CutToPart(40, 71, true, &taboo);
 
     //std::cout << fsm.PrintTimes() << std::endl;
 
-	std::ofstream dfaFile("DFA.txt");
-	dfaFile << fsm.PrintRegularAutomota(0, 0, "q", "t");
-	dfaFile.close();
+    std::ofstream dfaFile("DFA.txt");
+    dfaFile << fsm.PrintRegularAutomota(0, 0, "q", "t");
+    dfaFile.close();
     
-	//std::ofstream regFile("RLG.txt");
-	//regFile << fsm.PrintRightLinearGrammar(0, 0, "q", "y");
-	//regFile.close();
+    //std::ofstream regFile("RLG.txt");
+    //regFile << fsm.PrintRightLinearGrammar(0, 0, "q", "y");
+    //regFile.close();
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef CONVERT_TO_BINARY
+    // One time conversion, the binary log can be passed to the FSM instead of the JSON file
+    BinaryFrameLog::ConvertFromJson("TAreal.json", "TAreal.ctfl");
+#endif
+
+#ifdef BUILD_BATCH
+    // Every log gets its own machine, built in parallel on all hardware threads
+    BatchBuilder batch;
+    for (auto& result : batch.Build({ "TAreal.json", "TAreal.ctfl" }))
+        std::cout << result.filePath << ": "
+            << (result.fsm ? std::to_string(result.fsm->GetStateCount()) + " states" : result.error) << std::endl;
+#endif
+
+#ifdef GENERATE_SYNTHETIC
+    // Logs of a known process, with the states and transitions the learned machine recovers of it
+    SyntheticProcess process;
+    process.branchCount = 2;
+    SyntheticFrameSource synthetic(1000000, process);
+    synthetic.WriteTo("Synthetic.ctfl");
+    synthetic.WriteTo("Synthetic.json");
+
+    FSM learned("Synthetic.ctfl");
+    std::cout << synthetic.Compare(learned).Print();
+#endif
+
+#ifdef CHECK_CORRUPT_LOG
+    // A corrupt record in one chunk of a parallel read ends in its error, after the other chunks are finished
+    SyntheticFrameSource(2000000).WriteTo("Corrupt.ctfl");
+    {
+        std::vector<FrameChunk> chunks;
+        BinaryFrameReader("Corrupt.ctfl").SplitFrames(4, chunks);
+
+        // The first frame claims more changes than its record holds, so its chunk fails while the others are read
+        uint16_t changeCount = UINT16_MAX;
+        std::fstream corruptFile("Corrupt.ctfl", std::ios::in | std::ios::out | std::ios::binary);
+        corruptFile.seekp(chunks[0].offset + offsetof(BinaryFrameLog::FrameHeader, changeCount));
+        corruptFile.write(reinterpret_cast<const char*>(&changeCount), sizeof(changeCount));
+    }
+
+    try
+    {
+        FSM corrupt("Corrupt.ctfl", true, false, false, 4);
+        std::cerr << "Corrupt.ctfl was read without an error" << std::endl;
+        return 1;
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cout << error.what() << std::endl;
+    }
+#endif
+
+#ifdef BENCHMARK_INGESTION
+    // Frames per second of every reader, sequential and with parallel ingestion
+    struct Configuration { const char* filePath; bool streamFrames; unsigned int threadCount; };
+    for (auto& configuration : std::vector<Configuration>{
+        { "TAreal.json", false, 1 }, { "TAreal.json", false, 2 },
+        { "TAreal.json", true, 1 }, { "TAreal.json", true, 2 },
+        { "TAreal.ctfl", false, 1 }, { "TAreal.ctfl", false, 4 } })
+    {
+        auto start = std::chrono::steady_clock::now();
+        FSM benchmark(configuration.filePath, true, false, configuration.streamFrames, configuration.threadCount);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        std::cout << configuration.filePath << (configuration.streamFrames ? " streamed" : "")
+            << ", " << configuration.threadCount << " threads: "
+            << static_cast<uint64_t>(benchmark.GetFrameCount() / seconds.count()) << " frames/s" << std::endl;
+    }
+#endif
+
+#ifdef BENCHMARK_KERNELS
+    // Nanoseconds per call of every kernel level, on two images that differ in their last byte
+    for (std::size_t size : { 16u, 64u, 256u, 1024u, 4096u })
+    {
+        std::vector<unsigned char> previous(size);
+        for (std::size_t i = 0; i < size; ++i)
+            previous[i] = static_cast<unsigned char>(i * 31);
+        auto current = previous;
+        current[size - 1] ^= 1;
+
+        for (auto level : { ImageKernels::Level::Scalar, ImageKernels::Level::Sse2, ImageKernels::Level::Avx2 })
+        {
+            if (level > ImageKernels::GetSupportedLevel())
+                continue;
+            ImageKernels::SetLevel(level);
+
+            const std::size_t calls = (1 << 24) / size;
+            uint64_t sink = 0;
+            auto measure = [&](auto&& kernel)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (std::size_t call = 0; call < calls; ++call)
+                    sink += kernel(call);
+                std::chrono::duration<double, std::nano> nanoseconds = std::chrono::steady_clock::now() - start;
+                return nanoseconds.count() / calls;
+            };
+
+            auto equal = measure([&](std::size_t) { return ImageKernels::Equal(previous.data(), current.data(), size); });
+            auto hash = measure([&](std::size_t call) { return ImageKernels::Hash(current.data(), size, call); });
+
+            std::cout << size << " bytes, " << ImageKernels::GetLevelName(level) << ": equal " << equal
+                << " ns, hash " << hash << " ns" << (sink == 0 ? " " : "") << std::endl;
+        }
+    }
+    ImageKernels::SetLevel(ImageKernels::GetSupportedLevel());
+#endif
+
+#ifdef BENCHMARK_LAYOUT
+    // The generic registry against the layout of TAreal known at compile time, on frames held in memory
+    using TArealLayout = ProcessLayout<ParticipantLayout<12, 4, 20, 4>, ParticipantLayout<8, 4, 8, 4, 6>>;
+    MemoryFrameSource frames;
+    FrameSource::Open("TAreal.json")->ReadFrames([&frames](std::span<const Frame> batch)
+        {
+            for (auto& frame : batch)
+                frames.AddFrame(frame.timestamp, frame.isInput, frame.changes);
+        });
+
+    for (bool isFixed : { false, true })
+    {
+        const int repetitions = 20;
+        uint64_t frameCount = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repetitions; ++i)
+            frameCount += isFixed ? FSM(frames, TArealLayout()).GetFrameCount() : FSM(frames).GetFrameCount();
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        std::cout << (isFixed ? "Fixed layout: " : "Generic layout: ")
+            << static_cast<uint64_t>(frameCount / seconds.count()) << " frames/s" << std::endl;
+    }
 #endif
+
+#ifdef BENCHMARK_SUITE
+    // Every pass on the recorded logs and on synthetic logs of growing size, compare the JSON of two commits
+    BenchmarkSuite suite;
+    std::vector<std::string> logs = { "TAreal.json", "TAreal.ctfl" };
+    for (auto& entry : std::filesystem::directory_iterator("Data"))
+        if (entry.path().extension() == ".json")
+            logs.push_back(entry.path().string());
+
+    for (auto& log : logs)
+    {
+        auto error = suite.AddLog(log);
+        if (!error.empty())
+            std::cout << "Skipped " << log << ": " << error << std::endl;
+    }
+    for (uint64_t frameCount : { 10000, 100000, 1000000 })
+        suite.AddSyntheticLog(frameCount);
+
+    suite.Run();
+    std::cout << suite.PrintTable();
+    suite.WriteJson("BenchmarkResults.json");
+    return 0;
+#endif
+
+    // The analysis mode is chosen on the command line, all modes are part of the binary:
+    // --combined-states  Input and output are combined into one state
+    // --count-duplicates Counts the frames, that repeat the current state
+    // --no-unique-states Keeps the states as read, without combining them
+    bool combinedStates = false;
+    bool countDuplicates = false;
+    bool uniqueStates = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--combined-states")
+            combinedStates = true;
+        else if (argument == "--count-duplicates")
+            countDuplicates = true;
+        else if (argument == "--no-unique-states")
+            uniqueStates = false;
+        else
+        {
+            std::cerr << "Unknown argument " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    if (combinedStates)
+    {
+        if (countDuplicates)
+            Analyze<CombinedStates, CountDuplicates>("TAreal.json", uniqueStates);
+        else
+            Analyze<CombinedStates, IgnoreDuplicates>("TAreal.json", uniqueStates);
+    }
+    else
+    {
+        if (countDuplicates)
+            Analyze<SeparateStates, CountDuplicates>("TAreal.json", uniqueStates);
+        else
+            Analyze<SeparateStates, IgnoreDuplicates>("TAreal.json", uniqueStates);
+    }
+
+    return 0;
 }
\ No newline at end of file